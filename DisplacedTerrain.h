@@ -0,0 +1,185 @@
+#ifndef RECONSTRUCTION_DISPLACEDTERRAIN_H
+#define RECONSTRUCTION_DISPLACEDTERRAIN_H
+
+#include <glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "Grid2D.h"
+#include "MultiDraw.h"
+#include "TerrainQuadtree.h"
+#include "shader_m.h"
+
+// GPU-side terrain: the normalized heights live in an R32F texture and the colors in an RGB8 texture,
+// and shaders/terrain_displacement.vs rebuilds every grid vertex from gl_VertexID, so no vertex data
+// is stored at all. Chunk c owns the vertex IDs [c * chunkVertices, (c + 1) * chunkVertices) and a texel of the
+// chunk table buffer texture holding its first quad and width, so the shader finds its chunk from gl_VertexID
+// and every visible chunk is drawn by one multi-draw (MultiDraw.h). Changing the height range is a uniform
+// update and editing heights a glTexSubImage2D of the touched rectangle.
+//
+// gl_VertexID and the draw offsets are 32-bit signed ints; when the chunks' vertex IDs do not fit, every chunk
+// is drawn on its own from vertex 0 and the shader is given its index in chunkBase.
+class DisplacedTerrain {
+public:
+    bool visible = true;
+
+    GLuint vao = 0;
+    GLuint heightTexture = 0;
+    GLuint colorTexture = 0;
+    GLuint chunkBuffer = 0;
+    GLuint chunkTexture = 0;
+    GLint chunkVertices = 0;
+    bool batched = true;                // false when the vertex IDs of all chunks overflow a GLint
+    int rows = 0, cols = 0;
+    MultiDraw batch;
+    float escala = 1.0f;
+
+    DisplacedTerrain() = default;
+
+    DisplacedTerrain(const DisplacedTerrain &) = delete;
+
+    DisplacedTerrain &operator=(const DisplacedTerrain &) = delete;
+
+    ~DisplacedTerrain() {
+        if (heightTexture != 0)
+            glDeleteTextures(1, &heightTexture);
+        if (colorTexture != 0)
+            glDeleteTextures(1, &colorTexture);
+        if (chunkTexture != 0)
+            glDeleteTextures(1, &chunkTexture);
+        if (chunkBuffer != 0)
+            glDeleteBuffers(1, &chunkBuffer);
+        if (vao != 0)
+            glDeleteVertexArrays(1, &vao);
+    }
+
+    void setup(const Grid2D<const float> &heights, const Grid2D<const glm::u8vec3> &colors,
+               const std::vector<TerrainChunk> &chunks) {
+        rows = heights.rows();
+        cols = heights.cols();
+        if (vao == 0) {
+            // core profile draws need a bound VAO even without attributes
+            glGenVertexArrays(1, &vao);
+            glGenTextures(1, &heightTexture);
+            glGenTextures(1, &colorTexture);
+            glGenBuffers(1, &chunkBuffer);
+            glGenTextures(1, &chunkTexture);
+        }
+        setChunks(chunks);
+
+        glBindTexture(GL_TEXTURE_2D, heightTexture);
+        setSampling();
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, GLint(heights.stride()));
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, cols, rows, 0, GL_RED, GL_FLOAT, heights.data());
+
+        glBindTexture(GL_TEXTURE_2D, colorTexture);
+        setSampling();
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, GLint(colors.stride()));
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, cols, rows, 0, GL_RGB, GL_UNSIGNED_BYTE, colors.data());
+
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    // Fills the chunk table: (first quad row, first quad col, quads per row, 0) per chunk
+    void setChunks(const std::vector<TerrainChunk> &chunks) {
+        std::vector<GLint> table;
+        table.reserve(chunks.size() * 4);
+        int largest = 1;
+        for (const TerrainChunk &chunk: chunks) {
+            table.insert(table.end(), {chunk.row, chunk.col, chunk.cols, 0});
+            largest = std::max({largest, chunk.rows, chunk.cols});
+        }
+        chunkVertices = GLint(largest) * GLint(largest) * 6;
+        batched = chunks.size() * size_t(chunkVertices) <= size_t(INT_MAX);
+        if (!batched)
+            std::cerr << "Error: " << chunks.size() << " chunks of " << chunkVertices
+                      << " vertices overflow the vertex IDs, drawing them one per call" << std::endl;
+        glBindBuffer(GL_TEXTURE_BUFFER, chunkBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, GLsizeiptr(table.size() * sizeof(GLint)), table.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_BUFFER, chunkTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32I, chunkBuffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // Re-uploads the heights of a sub-rectangle (e.g. heights.subRect(...)) whose first sample is (row, col)
+    void updateHeights(const Grid2D<const float> &heights, int row, int col) {
+        glBindTexture(GL_TEXTURE_2D, heightTexture);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, GLint(heights.stride()));
+        glTexSubImage2D(GL_TEXTURE_2D, 0, col, row, heights.cols(), heights.rows(), GL_RED, GL_FLOAT,
+                        heights.data());
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    void display(Shader &sh, float cambio_escala, float minHeight, float maxHeight, float spacing,
+                 const std::vector<TerrainChunk> &chunks, const ChunkRun *runs, size_t runCount) {
+        escala = cambio_escala;
+        glm::mat4 model = glm::mat4(1.0);
+        model = scale(model, glm::vec3(escala));
+        sh.setMat4("model", model);
+        sh.setFloat("heightScale", maxHeight - minHeight);
+        sh.setFloat("heightOffset", minHeight);
+        sh.setFloat("spacing", spacing);
+        sh.setIVec2("gridSize", rows, cols);
+        sh.setInt("chunkVertices", chunkVertices);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, heightTexture);
+        sh.setInt("heightMap", 0);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, colorTexture);
+        sh.setInt("colorMap", 1);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_BUFFER, chunkTexture);
+        sh.setInt("chunkTable", 2);
+
+        if (visible && rows > 1 && cols > 1) {
+            glBindVertexArray(vao);
+            if (batched) {
+                sh.setInt("chunkBase", 0);
+                batch.clear();
+                for (size_t k = 0; k < runCount; k++) {
+                    for (int c = runs[k].first; c < runs[k].first + runs[k].count; c++)
+                        batch.addArrays(GLint(c) * chunkVertices,
+                                        GLsizei(chunks[c].rows) * GLsizei(chunks[c].cols) * 6);
+                }
+                batch.drawArrays(GL_TRIANGLES);
+            } else {
+                const GLint chunkBase = sh.uniformLocation("chunkBase");
+                for (size_t k = 0; k < runCount; k++) {
+                    for (int c = runs[k].first; c < runs[k].first + runs[k].count; c++) {
+                        sh.setInt(chunkBase, c);
+                        glDrawArrays(GL_TRIANGLES, 0, GLsizei(chunks[c].rows) * GLsizei(chunks[c].cols) * 6);
+                    }
+                }
+            }
+            glBindVertexArray(0);
+        }
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+private:
+    static void setSampling() {
+        // samples are read with texelFetch, but keep the textures complete without mipmaps
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+};
+
+#endif //RECONSTRUCTION_DISPLACEDTERRAIN_H
@@ -0,0 +1,212 @@
+#ifndef RECONSTRUCTION_FRAMEPROFILER_H
+#define RECONSTRUCTION_FRAMEPROFILER_H
+
+#include <glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "Trace.h"
+
+// Per-stage frame timings: each stage is bracketed by a CPU timer and a GL_TIME_ELAPSED query. Queries
+// alternate between two sets, so a frame reads the results of the frame before last, which the GPU has
+// normally finished by then; results that are still not available are dropped instead of waited for.
+// Statistics cover the last WINDOW frames.
+class FrameProfiler {
+public:
+    enum Stage {
+        CLEAR, MAP, LIGHT_CUBE, OVERLAY, SWAP, STAGE_COUNT
+    };
+
+    static const int WINDOW = 120;
+
+    struct Statistics {
+        double mean = 0, max = 0; // milliseconds
+    };
+
+    // Times a stage for as long as it is in scope, and traces it as a zone; only the zone is recorded
+    // without a profiler
+    class Scope {
+    public:
+        Scope(FrameProfiler *profiler, Stage stage) : profiler(profiler), stage(stage), zone(stageName(stage)) {
+            if (profiler != nullptr)
+                profiler->begin(stage);
+        }
+
+        Scope(const Scope &) = delete;
+
+        Scope &operator=(const Scope &) = delete;
+
+        ~Scope() {
+            if (profiler != nullptr)
+                profiler->end(stage);
+        }
+
+    private:
+        FrameProfiler *profiler;
+        Stage stage;
+        Trace::Zone zone;
+    };
+
+    FrameProfiler() = default;
+
+    FrameProfiler(const FrameProfiler &) = delete;
+
+    FrameProfiler &operator=(const FrameProfiler &) = delete;
+
+    ~FrameProfiler() {
+        if (queries[0][0] != 0)
+            glDeleteQueries(2 * STAGE_COUNT, &queries[0][0]);
+    }
+
+    static const char *stageName(int stage) {
+        static const char *names[STAGE_COUNT] = {"clear", "map", "light cube", "overlay", "swap"};
+        return names[stage];
+    }
+
+    void setup() {
+        glGenQueries(2 * STAGE_COUNT, &queries[0][0]);
+    }
+
+    void beginFrame() {
+        auto now = std::chrono::steady_clock::now();
+        if (frames > 0)
+            frameCpu.add(std::chrono::duration<double, std::milli>(now - frameStart).count());
+        frameStart = now;
+        frames++;
+        set = int(frames & 1);
+        for (int stage = 0; stage < STAGE_COUNT; stage++) {
+            if (!issued[set][stage])
+                continue;
+            issued[set][stage] = false;
+            GLint available = 0;
+            glGetQueryObjectiv(queries[set][stage], GL_QUERY_RESULT_AVAILABLE, &available);
+            GLuint64 nanoseconds = 0;
+            if (available)
+                glGetQueryObjectui64v(queries[set][stage], GL_QUERY_RESULT, &nanoseconds);
+            // llvmpipe answers a query around a lone clear with a timestamp instead of a duration
+            if (available && nanoseconds < MAX_GPU_NANOSECONDS)
+                gpu[stage].add(double(nanoseconds) * 1e-6);
+        }
+    }
+
+    // Stages must not overlap: only one GL_TIME_ELAPSED query can be active at a time
+    void begin(Stage stage) {
+        glBeginQuery(GL_TIME_ELAPSED, queries[set][stage]);
+        stageStart = std::chrono::steady_clock::now();
+    }
+
+    void end(Stage stage) {
+        cpu[stage].add(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stageStart).count());
+        glEndQuery(GL_TIME_ELAPSED);
+        issued[set][stage] = true;
+    }
+
+    Statistics cpuStatistics(int stage) const {
+        return cpu[stage].statistics();
+    }
+
+    Statistics gpuStatistics(int stage) const {
+        return gpu[stage].statistics();
+    }
+
+    // Time between consecutive beginFrame() calls
+    Statistics frameStatistics() const {
+        return frameCpu.statistics();
+    }
+
+    // Table of the rolling statistics for the overlay
+    std::string summary() const {
+        Statistics frame = frameStatistics();
+        char line[128];
+        std::snprintf(line, sizeof(line), "frame %6.2f ms (%5.1f fps), max %6.2f ms\n", frame.mean,
+                      frame.mean > 0 ? 1000.0 / frame.mean : 0.0, frame.max);
+        std::string text = line;
+        std::snprintf(line, sizeof(line), "%-11s %8s %6s %8s %6s\n", "stage", "cpu avg", "max", "gpu avg", "max");
+        text += line;
+        for (int stage = 0; stage < STAGE_COUNT; stage++) {
+            Statistics c = cpuStatistics(stage), g = gpuStatistics(stage);
+            std::snprintf(line, sizeof(line), "%-11s %8.3f %6.2f %8.3f %6.2f\n", stageName(stage), c.mean, c.max,
+                          g.mean, g.max);
+            text += line;
+        }
+        return text;
+    }
+
+    // Appends the current statistics to a dump: a CSV row (with a header before the first one) or, for files
+    // ending in .json, one JSON object per line
+    void dump(std::FILE *out, bool json, double seconds) {
+        Statistics frame = frameStatistics();
+        if (json) {
+            std::fprintf(out, "{\"time\": %.3f, \"frameMs\": {\"mean\": %.4f, \"max\": %.4f}, \"stages\": {", seconds,
+                         frame.mean, frame.max);
+            for (int stage = 0; stage < STAGE_COUNT; stage++) {
+                Statistics c = cpuStatistics(stage), g = gpuStatistics(stage);
+                std::fprintf(out, "%s\"%s\": {\"cpuMean\": %.4f, \"cpuMax\": %.4f, \"gpuMean\": %.4f, \"gpuMax\": %.4f}",
+                             stage == 0 ? "" : ", ", stageName(stage), c.mean, c.max, g.mean, g.max);
+            }
+            std::fprintf(out, "}}\n");
+        } else {
+            if (!wroteHeader) {
+                std::fprintf(out, "time,frame_mean_ms,frame_max_ms");
+                for (int stage = 0; stage < STAGE_COUNT; stage++) {
+                    std::string name = stageName(stage);
+                    std::replace(name.begin(), name.end(), ' ', '_');
+                    std::fprintf(out, ",%s_cpu_mean_ms,%s_cpu_max_ms,%s_gpu_mean_ms,%s_gpu_max_ms", name.c_str(),
+                                 name.c_str(), name.c_str(), name.c_str());
+                }
+                std::fprintf(out, "\n");
+                wroteHeader = true;
+            }
+            std::fprintf(out, "%.3f,%.4f,%.4f", seconds, frame.mean, frame.max);
+            for (int stage = 0; stage < STAGE_COUNT; stage++) {
+                Statistics c = cpuStatistics(stage), g = gpuStatistics(stage);
+                std::fprintf(out, ",%.4f,%.4f,%.4f,%.4f", c.mean, c.max, g.mean, g.max);
+            }
+            std::fprintf(out, "\n");
+        }
+        std::fflush(out);
+    }
+
+private:
+    // Last WINDOW samples of one series
+    class Rolling {
+    public:
+        void add(double value) {
+            if (samples.size() < size_t(WINDOW))
+                samples.push_back(value);
+            else
+                samples[next] = value;
+            next = (next + 1) % WINDOW;
+        }
+
+        Statistics statistics() const {
+            Statistics result;
+            for (double value: samples) {
+                result.mean += value;
+                result.max = std::max(result.max, value);
+            }
+            if (!samples.empty())
+                result.mean /= double(samples.size());
+            return result;
+        }
+
+    private:
+        std::vector<double> samples;
+        size_t next = 0;
+    };
+
+    static constexpr GLuint64 MAX_GPU_NANOSECONDS = 10000000000ull;
+
+    GLuint queries[2][STAGE_COUNT] = {};
+    bool issued[2][STAGE_COUNT] = {};
+    int set = 0;
+    unsigned long long frames = 0;
+    std::chrono::steady_clock::time_point frameStart, stageStart;
+    Rolling cpu[STAGE_COUNT], gpu[STAGE_COUNT], frameCpu;
+    bool wroteHeader = false;
+};
+
+#endif //RECONSTRUCTION_FRAMEPROFILER_H
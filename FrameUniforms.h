@@ -0,0 +1,60 @@
+#ifndef RECONSTRUCTION_FRAMEUNIFORMS_H
+#define RECONSTRUCTION_FRAMEUNIFORMS_H
+
+#include <glad.h>
+
+#include <glm/glm.hpp>
+#include "shader_m.h"
+
+// Values that are the same for every draw of a frame, shared by all shaders through the std140 `FrameData`
+// uniform block, so they are uploaded once per frame instead of once per shader. The block is declared
+// identically in every shader under shaders/.
+class FrameUniforms {
+public:
+    // std140: mat4 columns and vec4s are 16-byte aligned, so this matches the GLSL block byte for byte
+    struct Block {
+        glm::mat4 projection;
+        glm::mat4 view;
+        glm::vec4 viewPos;
+        glm::vec4 lightPos;
+        glm::vec4 lightColor;
+    };
+    static_assert(sizeof(Block) == 176, "FrameUniforms::Block must match the std140 FrameData block");
+
+    static const GLuint BINDING = 0;
+
+    GLuint ubo = 0;
+
+    FrameUniforms() = default;
+
+    FrameUniforms(const FrameUniforms &) = delete;
+
+    FrameUniforms &operator=(const FrameUniforms &) = delete;
+
+    ~FrameUniforms() {
+        if (ubo != 0)
+            glDeleteBuffers(1, &ubo);
+    }
+
+    void setup() {
+        if (ubo == 0)
+            glGenBuffers(1, &ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, ubo);
+    }
+
+    // Points the shader's FrameData block at this buffer
+    static void attach(const Shader &sh) {
+        sh.bindUniformBlock("FrameData", BINDING);
+    }
+
+    void update(const Block &block) {
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+};
+
+#endif //RECONSTRUCTION_FRAMEUNIFORMS_H
@@ -0,0 +1,55 @@
+#ifndef RECONSTRUCTION_FRUSTUM_H
+#define RECONSTRUCTION_FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+// View frustum as six planes (ax + by + cz + d >= 0 inside), extracted from a projection * view (* model)
+// matrix, so boxes are tested in whatever space that matrix maps from.
+class Frustum {
+public:
+    enum Containment {
+        OUTSIDE,
+        INTERSECTS,
+        INSIDE
+    };
+
+    glm::vec4 planes[6];
+
+    Frustum() = default;
+
+    explicit Frustum(const glm::mat4 &m) {
+        // rows of the matrix (glm is column-major)
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+        planes[0] = row3 + row0; // left
+        planes[1] = row3 - row0; // right
+        planes[2] = row3 + row1; // bottom
+        planes[3] = row3 - row1; // top
+        planes[4] = row3 + row2; // near
+        planes[5] = row3 - row2; // far
+        for (auto &plane: planes)
+            plane /= glm::length(glm::vec3(plane));
+    }
+
+    // Axis-aligned box test; INSIDE means no plane cuts the box
+    Containment classify(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) const {
+        Containment result = INSIDE;
+        for (const auto &plane: planes) {
+            glm::vec3 normal(plane);
+            // corners furthest along and against the plane normal
+            glm::vec3 positive(normal.x >= 0 ? boundsMax.x : boundsMin.x, normal.y >= 0 ? boundsMax.y : boundsMin.y,
+                               normal.z >= 0 ? boundsMax.z : boundsMin.z);
+            glm::vec3 negative(normal.x >= 0 ? boundsMin.x : boundsMax.x, normal.y >= 0 ? boundsMin.y : boundsMax.y,
+                               normal.z >= 0 ? boundsMin.z : boundsMax.z);
+            if (glm::dot(normal, positive) + plane.w < 0)
+                return OUTSIDE;
+            if (glm::dot(normal, negative) + plane.w < 0)
+                result = INTERSECTS;
+        }
+        return result;
+    }
+};
+
+#endif //RECONSTRUCTION_FRUSTUM_H
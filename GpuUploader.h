@@ -0,0 +1,272 @@
+#ifndef RECONSTRUCTION_GPUUPLOADER_H
+#define RECONSTRUCTION_GPUUPLOADER_H
+
+#include <glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "Trace.h"
+
+// Streams buffer data to the GPU without stalling the render thread. Data handed over (e.g. a
+// mesh a worker thread built) is queued; every frame process() copies at most the frame budget of it into a
+// staging ring and has the GPU copy it from there into the destination, so a large upload is spread over
+// several frames instead of hitching one. A fence per frame tells when the GPU has read a part of the ring
+// and it may be written again.
+//
+// With buffer storage (GL 4.4 or ARB_buffer_storage) the ring is mapped once, persistently and coherently,
+// and staging is a memcpy. On GL 3.3 each staged range is mapped unsynchronized instead, and when the ring is
+// full the buffer is orphaned rather than waited for.
+const size_t DEFAULT_UPLOAD_RING_BYTES = size_t(32) << 20;
+const size_t DEFAULT_UPLOAD_FRAME_BUDGET = size_t(8) << 20;
+
+class GpuUploader {
+public:
+    // Upload traffic of the last process() call
+    struct FrameStats {
+        size_t bytes = 0;           // staged this frame
+        size_t completed = 0;       // uploads finished this frame
+        size_t pendingBytes = 0;    // still queued
+        bool ringFull = false;      // the budget was left unused because the GPU still reads the ring
+    };
+
+    GpuUploader() = default;
+
+    GpuUploader(const GpuUploader &) = delete;
+
+    GpuUploader &operator=(const GpuUploader &) = delete;
+
+    ~GpuUploader() {
+        for (const Region &region: regions)
+            glDeleteSync(region.fence);
+        if (ring != 0)
+            glDeleteBuffers(1, &ring);
+    }
+
+    // Creates the staging ring; needs a current context
+    void setup(size_t ringBytes = DEFAULT_UPLOAD_RING_BYTES) {
+        TRACE_ZONE("GpuUploader::setup");
+        capacity = ringBytes;
+        glGenBuffers(1, &ring);
+        glBindBuffer(GL_COPY_READ_BUFFER, ring);
+        if (GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage) {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_COPY_READ_BUFFER, GLsizeiptr(capacity), nullptr, flags);
+            mapped = static_cast<unsigned char *>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, GLsizeiptr(capacity),
+                                                                   flags));
+        } else {
+            glBufferData(GL_COPY_READ_BUFFER, GLsizeiptr(capacity), nullptr, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+
+    bool persistent() const {
+        return mapped != nullptr;
+    }
+
+    // Bytes staged per process() call at most; an upload larger than this takes several frames
+    void set_frame_budget(size_t bytes) {
+        frameBudget = std::max<size_t>(bytes, 1);
+    }
+
+    size_t frame_budget() const {
+        return frameBudget;
+    }
+
+    // Queues `data` for `buffer` at byte `offset`; the buffer must already have its storage. `done` runs on the
+    // render thread, from process(), once the GPU has been told to copy the last byte, so draws issued after
+    // it see the data
+    template<typename T>
+    void upload(GLuint buffer, size_t offset, std::vector<T> data, std::function<void()> done = {}) {
+        Job job;
+        job.target = buffer;
+        job.offset = offset;
+        job.size = data.size() * sizeof(T);
+        job.done = std::move(done);
+        adopt(job, std::move(data));
+        pushJob(std::move(job));
+    }
+
+    size_t pending_bytes() const {
+        return pendingBytes;
+    }
+
+    bool idle() const {
+        return jobs.empty();
+    }
+
+    // Stages up to the frame budget of the queue and fences it; call once per frame on the render thread
+    void process() {
+        TRACE_ZONE("GpuUploader::process");
+        stats = FrameStats();
+        if (ring == 0)
+            return;
+        retire();
+        size_t budget = frameBudget;
+        size_t staged = 0;
+        while (!jobs.empty() && budget > 0) {
+            Job &job = jobs.front();
+            const size_t bytes = std::min({job.size - job.copied, budget, capacity});
+            size_t offset;
+            if (!allocate(bytes, offset)) {
+                stats.ringFull = true;
+                break;
+            }
+            stage(offset, job.data + job.copied, bytes);
+            copy(job, offset, bytes);
+            job.copied += bytes;
+            pendingBytes -= bytes;
+            budget -= std::min(budget, bytes);
+            staged += bytes;
+            if (job.copied == job.size) {
+                std::function<void()> done = std::move(job.done);
+                jobs.pop_front();
+                stats.completed++;
+                if (done)
+                    done();
+            }
+        }
+        if (frameBytes > 0) {
+            regions.push_back({glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), head, frameBytes});
+            frameBytes = 0;
+        }
+        stats.bytes = staged;
+        stats.pendingBytes = pendingBytes;
+    }
+
+    const FrameStats &frame_stats() const {
+        return stats;
+    }
+
+private:
+    struct Job {
+        GLuint target = 0;
+        size_t offset = 0;                  // destination byte offset
+        std::shared_ptr<void> owner;        // keeps the data alive
+        const unsigned char *data = nullptr;
+        size_t size = 0, copied = 0;
+        std::function<void()> done;
+    };
+
+    // Ring bytes handed out in one frame, free again once the fence has signalled
+    struct Region {
+        GLsync fence;
+        size_t end;
+        size_t bytes;   // including what was skipped at the end of the ring to wrap
+    };
+
+    GLuint ring = 0;
+    unsigned char *mapped = nullptr;
+    size_t capacity = 0;
+    size_t head = 0, tail = 0, busy = 0;    // next free byte, oldest byte in flight, bytes in flight
+    size_t frameBytes = 0;
+    size_t frameBudget = DEFAULT_UPLOAD_FRAME_BUDGET;
+    std::deque<Region> regions;
+    std::deque<Job> jobs;
+    size_t pendingBytes = 0;
+    FrameStats stats;
+
+    template<typename T>
+    static void adopt(Job &job, std::vector<T> data) {
+        auto owned = std::make_shared<std::vector<T>>(std::move(data));
+        job.data = reinterpret_cast<const unsigned char *>(owned->data());
+        job.owner = std::move(owned);
+    }
+
+    void pushJob(Job job) {
+        if (job.size == 0) {
+            if (job.done)
+                job.done();
+            return;
+        }
+        pendingBytes += job.size;
+        jobs.push_back(std::move(job));
+    }
+
+    // Frees the regions the GPU is done with, oldest first, without waiting
+    void retire() {
+        while (!regions.empty()) {
+            GLenum status = glClientWaitSync(regions.front().fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                break;
+            glDeleteSync(regions.front().fence);
+            tail = regions.front().end;
+            busy -= regions.front().bytes;
+            regions.pop_front();
+        }
+    }
+
+    // Hands out `bytes` contiguous ring bytes; 256-byte aligned, which suits every copy offset
+    bool allocate(size_t bytes, size_t &offset) {
+        const size_t size = std::min((bytes + 255) & ~size_t(255), capacity);
+        if (busy == 0)
+            head = tail = 0;
+        if (busy < capacity && head >= tail) {
+            if (capacity - head >= size) {
+                offset = head;
+                head += size;
+                busy += size;
+                frameBytes += size;
+                return true;
+            }
+            if (tail >= size) {
+                // skip the end of the ring and start over at the front
+                const size_t skipped = capacity - head;
+                offset = 0;
+                head = size;
+                busy += skipped + size;
+                frameBytes += skipped + size;
+                return true;
+            }
+        } else if (head < tail && tail - head >= size) {
+            offset = head;
+            head += size;
+            busy += size;
+            frameBytes += size;
+            return true;
+        }
+        if (persistent())
+            return false;
+        // GL 3.3: orphan the ring so the driver hands out fresh storage while the GPU reads the old one
+        glBindBuffer(GL_COPY_READ_BUFFER, ring);
+        glBufferData(GL_COPY_READ_BUFFER, GLsizeiptr(capacity), nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        for (const Region &region: regions)
+            glDeleteSync(region.fence);
+        regions.clear();
+        head = tail = busy = frameBytes = 0;
+        return allocate(bytes, offset);
+    }
+
+    void stage(size_t offset, const unsigned char *data, size_t bytes) {
+        if (persistent()) {
+            std::memcpy(mapped + offset, data, bytes);
+            return;
+        }
+        // the range is free (its fence signalled or the ring was orphaned), so no synchronization is needed
+        glBindBuffer(GL_COPY_READ_BUFFER, ring);
+        void *target = glMapBufferRange(GL_COPY_READ_BUFFER, GLintptr(offset), GLsizeiptr(bytes),
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (target != nullptr) {
+            std::memcpy(target, data, bytes);
+            glUnmapBuffer(GL_COPY_READ_BUFFER);
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+
+    void copy(const Job &job, size_t offset, size_t bytes) {
+        glBindBuffer(GL_COPY_READ_BUFFER, ring);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, job.target);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GLintptr(offset),
+                            GLintptr(job.offset + job.copied), GLsizeiptr(bytes));
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+};
+
+#endif //RECONSTRUCTION_GPUUPLOADER_H
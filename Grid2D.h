@@ -0,0 +1,114 @@
+#ifndef RECONSTRUCTION_GRID2D_H
+#define RECONSTRUCTION_GRID2D_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <type_traits>
+
+// Row-major 2D array of samples. Owned grids live in one allocation aligned to GRID_ALIGNMENT, with
+// every row padded so it also starts on that boundary; `stride` is the distance between rows in
+// elements. Views (of external memory or sub-rectangles of another grid) reuse the same interface.
+// Copies are shallow: they share the samples and keep the allocation alive.
+const size_t GRID_ALIGNMENT = 64;
+
+template<typename T>
+class Grid2D {
+    template<typename> friend
+    class Grid2D;
+
+    using Value = typename std::remove_const<T>::type;
+
+    std::shared_ptr<void> storage;
+    T *base = nullptr;
+    int rowCount = 0;
+    int colCount = 0;
+    size_t rowStride = 0;
+
+    static size_t paddedStride(int cols) {
+        // smallest element count whose byte size is a multiple of the alignment
+        size_t step = GRID_ALIGNMENT / std::gcd(GRID_ALIGNMENT, sizeof(Value));
+        return (size_t(cols) + step - 1) / step * step;
+    }
+
+public:
+    Grid2D() = default;
+
+    // Owned grid with every sample set to `fill`
+    Grid2D(int rows, int cols, const Value &fill = Value()) : rowCount(rows), colCount(cols),
+                                                               rowStride(paddedStride(cols)) {
+        size_t count = rowStride * size_t(rows);
+        Value *samples = static_cast<Value *>(::operator new(count * sizeof(Value),
+                                                             std::align_val_t(GRID_ALIGNMENT)));
+        for (size_t k = 0; k < count; k++)
+            new(samples + k) Value(fill);
+        storage = std::shared_ptr<void>(samples, [](void *p) {
+            static_assert(std::is_trivially_destructible<Value>::value, "Grid2D holds plain samples");
+            ::operator delete(p, std::align_val_t(GRID_ALIGNMENT));
+        });
+        base = samples;
+    }
+
+    // Non-owning view of external memory; `stride` defaults to a tightly packed grid
+    static Grid2D view(T *data, int rows, int cols, size_t stride = 0) {
+        Grid2D grid;
+        grid.base = data;
+        grid.rowCount = rows;
+        grid.colCount = cols;
+        grid.rowStride = stride != 0 ? stride : size_t(cols);
+        return grid;
+    }
+
+    // A mutable grid converts to a read-only one over the same samples
+    template<typename U, typename = typename std::enable_if<std::is_same<const U, T>::value>::type>
+    Grid2D(const Grid2D<U> &other) : storage(other.storage), base(other.base), rowCount(other.rowCount),
+                                     colCount(other.colCount), rowStride(other.rowStride) {}
+
+    // View of rows [row, row + rows) and columns [col, col + cols), sharing this grid's samples
+    Grid2D subRect(int row, int col, int rows, int cols) const {
+        Grid2D grid = *this;
+        grid.base = base + size_t(row) * rowStride + col;
+        grid.rowCount = rows;
+        grid.colCount = cols;
+        return grid;
+    }
+
+    int rows() const {
+        return rowCount;
+    }
+
+    int cols() const {
+        return colCount;
+    }
+
+    size_t stride() const {
+        return rowStride;
+    }
+
+    bool empty() const {
+        return base == nullptr || rowCount == 0 || colCount == 0;
+    }
+
+    bool contiguous() const {
+        return rowStride == size_t(colCount);
+    }
+
+    size_t size() const {
+        return size_t(rowCount) * colCount;
+    }
+
+    T *data() const {
+        return base;
+    }
+
+    T *row(int i) const {
+        return base + size_t(i) * rowStride;
+    }
+
+    T &operator()(int i, int j) const {
+        return base[size_t(i) * rowStride + j];
+    }
+};
+
+#endif //RECONSTRUCTION_GRID2D_H
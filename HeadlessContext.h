@@ -0,0 +1,99 @@
+#ifndef RECONSTRUCTION_HEADLESSCONTEXT_H
+#define RECONSTRUCTION_HEADLESSCONTEXT_H
+
+#include <iostream>
+
+#ifdef __linux__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+// OpenGL 3.3 core context without a window system, for rendering on machines with no display. It uses
+// EGL's surfaceless platform (Mesa; llvmpipe when there is no GPU) and falls back to the default EGL
+// display. The context has no default framebuffer, so everything must be drawn into an OffscreenTarget.
+class HeadlessContext {
+public:
+    HeadlessContext() = default;
+
+    HeadlessContext(const HeadlessContext &) = delete;
+
+    HeadlessContext &operator=(const HeadlessContext &) = delete;
+
+#ifdef __linux__
+    ~HeadlessContext() {
+        if (display == EGL_NO_DISPLAY)
+            return;
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context != EGL_NO_CONTEXT)
+            eglDestroyContext(display, context);
+        eglTerminate(display);
+    }
+
+    // Creates the context and makes it current on the calling thread
+    bool create() {
+        auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay != nullptr)
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (display == EGL_NO_DISPLAY)
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        EGLint major, minor;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+            std::cout << "Failed to initialize EGL" << std::endl;
+            display = EGL_NO_DISPLAY;
+            return false;
+        }
+        if (!eglBindAPI(EGL_OPENGL_API)) {
+            std::cout << "EGL display does not support desktop OpenGL" << std::endl;
+            return false;
+        }
+        const EGLint configAttributes[] = {
+                EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+                EGL_NONE
+        };
+        EGLConfig config;
+        EGLint configCount = 0;
+        if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+            std::cout << "No EGL config for an OpenGL context" << std::endl;
+            return false;
+        }
+        const EGLint contextAttributes[] = {
+                EGL_CONTEXT_MAJOR_VERSION, 3,
+                EGL_CONTEXT_MINOR_VERSION, 3,
+                EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                EGL_NONE
+        };
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+        if (context == EGL_NO_CONTEXT) {
+            std::cout << "Failed to create an OpenGL 3.3 core context" << std::endl;
+            return false;
+        }
+        if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+            std::cout << "Failed to make the surfaceless context current" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Loader for gladLoadGLLoader
+    static void *procAddress(const char *name) {
+        return (void *) eglGetProcAddress(name);
+    }
+
+private:
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+#else
+    bool create() {
+        std::cout << "Headless rendering needs EGL and is only available on Linux" << std::endl;
+        return false;
+    }
+
+    static void *procAddress(const char *) {
+        return nullptr;
+    }
+#endif
+};
+
+#endif //RECONSTRUCTION_HEADLESSCONTEXT_H
@@ -0,0 +1,368 @@
+#ifndef RECONSTRUCTION_HEIGHTMAPIO_H
+#define RECONSTRUCTION_HEIGHTMAPIO_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include "Grid2D.h"
+#include "TextGridParser.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// World heights of normalized 0 and 1 when a map does not give its own range (main.cpp's, and the tools')
+const float DEFAULT_MIN_HEIGHT = -10.0f;
+const float DEFAULT_MAX_HEIGHT = 0.0f;
+
+// Binary heightmap container (.hmap). Little-endian, laid out as
+//   HeightmapHeader | heights (rows * cols, row-major) | rgb (rows * cols * 3 bytes, optional)
+// Heights are normalized to [0, 1] exactly like the .e text files; minHeight/maxHeight give the
+// world range they map to. Each payload starts on a HEIGHTMAP_ALIGNMENT boundary so a mapped file
+// can be read in place.
+const char HEIGHTMAP_MAGIC[4] = {'R', 'H', 'M', 'P'};
+const uint32_t HEIGHTMAP_VERSION = 1;
+const uint32_t HEIGHTMAP_HAS_RGB = 1u << 0;
+const uint64_t HEIGHTMAP_ALIGNMENT = 64;
+
+enum HeightFormat : uint32_t {
+    HEIGHT_FLOAT32 = 0,
+    HEIGHT_UNORM16 = 1
+};
+
+struct HeightmapHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t rows;
+    uint32_t cols;
+    float minHeight;
+    float maxHeight;
+    uint32_t format;
+    uint32_t flags;
+    uint64_t heightOffset;
+    uint64_t rgbOffset;
+};
+
+static_assert(sizeof(HeightmapHeader) == 48, "HeightmapHeader must stay binary compatible");
+
+inline uint64_t alignHeightmapOffset(uint64_t offset) {
+    return (offset + HEIGHTMAP_ALIGNMENT - 1) & ~(HEIGHTMAP_ALIGNMENT - 1);
+}
+
+inline size_t heightFormatSize(uint32_t format) {
+    return format == HEIGHT_UNORM16 ? sizeof(uint16_t) : sizeof(float);
+}
+
+// Read-only memory mapping of a whole file. Files read front to back are prefetched; files read in small
+// pieces (such as a tile set) are mapped with `prefetch` off, and drop() lets go of pages already read.
+class MappedFile {
+    const unsigned char *bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+public:
+    MappedFile() = default;
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile() {
+        close();
+    }
+
+    bool open(const std::string &path, bool prefetch = true) {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                           prefetch ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+            close();
+            return false;
+        }
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr) {
+            close();
+            return false;
+        }
+        bytes = static_cast<const unsigned char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        length = size_t(fileSize.QuadPart);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void *view = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        // The mapping keeps its own reference to the file
+        ::close(fd);
+        if (view == MAP_FAILED)
+            return false;
+        madvise(view, size_t(st.st_size), prefetch ? MADV_WILLNEED : MADV_RANDOM);
+        bytes = static_cast<const unsigned char *>(view);
+        length = size_t(st.st_size);
+#endif
+        if (bytes == nullptr) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (bytes != nullptr)
+            UnmapViewOfFile(bytes);
+        if (mapping != nullptr)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (bytes != nullptr)
+            munmap(const_cast<unsigned char *>(bytes), length);
+#endif
+        bytes = nullptr;
+        length = 0;
+    }
+
+    // Releases the resident pages of [offset, offset + count); they are read from the file again if touched
+    void drop(size_t offset, size_t count) const {
+#ifndef _WIN32
+        const size_t page = size_t(sysconf(_SC_PAGESIZE));
+        size_t first = offset / page * page, last = std::min(offset + count, length);
+        if (bytes != nullptr && last > first)
+            madvise(const_cast<unsigned char *>(bytes) + first, last - first, MADV_DONTNEED);
+#else
+        (void) offset;
+        (void) count;
+#endif
+    }
+
+    const unsigned char *data() const {
+        return bytes;
+    }
+
+    size_t size() const {
+        return length;
+    }
+};
+
+// A mapped .hmap file. The payload pointers stay valid for as long as the object is open.
+class HeightmapFile {
+    MappedFile file;
+    HeightmapHeader head{};
+public:
+    bool open(const std::string &path) {
+        if (!file.open(path)) {
+            std::cerr << "Error: Could not map the file " << path << std::endl;
+            return false;
+        }
+        if (file.size() < sizeof(HeightmapHeader)) {
+            std::cerr << "Error: " << path << " is too small to be a heightmap" << std::endl;
+            file.close();
+            return false;
+        }
+        std::memcpy(&head, file.data(), sizeof(HeightmapHeader));
+        if (std::memcmp(head.magic, HEIGHTMAP_MAGIC, sizeof(HEIGHTMAP_MAGIC)) != 0 ||
+            head.version != HEIGHTMAP_VERSION || head.format > HEIGHT_UNORM16) {
+            std::cerr << "Error: " << path << " is not a version " << HEIGHTMAP_VERSION << " heightmap" << std::endl;
+            file.close();
+            return false;
+        }
+        uint64_t samples = uint64_t(head.rows) * head.cols;
+        bool heightsFit = head.heightOffset % HEIGHTMAP_ALIGNMENT == 0 &&
+                          head.heightOffset + samples * heightFormatSize(head.format) <= file.size();
+        bool rgbFits = !(head.flags & HEIGHTMAP_HAS_RGB) ||
+                       head.rgbOffset + samples * sizeof(glm::u8vec3) <= file.size();
+        if (!heightsFit || !rgbFits) {
+            std::cerr << "Error: " << path << " is truncated" << std::endl;
+            file.close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        file.close();
+    }
+
+    bool isOpen() const {
+        return file.data() != nullptr;
+    }
+
+    const HeightmapHeader &header() const {
+        return head;
+    }
+
+    bool hasRGB() const {
+        return (head.flags & HEIGHTMAP_HAS_RGB) != 0;
+    }
+
+    // Views straight into the mapping; the one that does not match the stored format is empty
+    Grid2D<const float> heights32() const {
+        if (head.format != HEIGHT_FLOAT32)
+            return {};
+        return Grid2D<const float>::view(reinterpret_cast<const float *>(file.data() + head.heightOffset),
+                                         int(head.rows), int(head.cols));
+    }
+
+    Grid2D<const uint16_t> heights16() const {
+        if (head.format != HEIGHT_UNORM16)
+            return {};
+        return Grid2D<const uint16_t>::view(reinterpret_cast<const uint16_t *>(file.data() + head.heightOffset),
+                                            int(head.rows), int(head.cols));
+    }
+
+    Grid2D<const glm::u8vec3> rgb() const {
+        if (!hasRGB())
+            return {};
+        return Grid2D<const glm::u8vec3>::view(reinterpret_cast<const glm::u8vec3 *>(file.data() + head.rgbOffset),
+                                               int(head.rows), int(head.cols));
+    }
+
+    // Writes normalized heights (and colors, unless `rgb` is empty) as a .hmap file
+    static bool write(const std::string &path, float minHeight, float maxHeight, const Grid2D<const float> &heights,
+                      const Grid2D<const glm::u8vec3> &rgb, HeightFormat format = HEIGHT_FLOAT32) {
+        std::ofstream out(path, std::ios::binary);
+        if (!out.is_open()) {
+            std::cerr << "Error: Could not open the file " << path << std::endl;
+            return false;
+        }
+        const int rows = heights.rows(), cols = heights.cols();
+        size_t samples = heights.size();
+        bool withRGB = !rgb.empty() && rgb.rows() == rows && rgb.cols() == cols;
+
+        HeightmapHeader header{};
+        std::memcpy(header.magic, HEIGHTMAP_MAGIC, sizeof(HEIGHTMAP_MAGIC));
+        header.version = HEIGHTMAP_VERSION;
+        header.rows = uint32_t(rows);
+        header.cols = uint32_t(cols);
+        header.minHeight = minHeight;
+        header.maxHeight = maxHeight;
+        header.format = format;
+        header.flags = withRGB ? HEIGHTMAP_HAS_RGB : 0;
+        header.heightOffset = alignHeightmapOffset(sizeof(HeightmapHeader));
+        header.rgbOffset = withRGB ? alignHeightmapOffset(header.heightOffset + samples * heightFormatSize(format)) : 0;
+
+        auto pad = [&out](uint64_t offset) {
+            static const char zeros[HEIGHTMAP_ALIGNMENT] = {};
+            uint64_t position = uint64_t(out.tellp());
+            out.write(zeros, std::streamsize(offset - position));
+        };
+
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        pad(header.heightOffset);
+        std::vector<uint16_t> packed(format == HEIGHT_UNORM16 ? size_t(cols) : 0);
+        for (int i = 0; i < rows; i++) {
+            const float *row = heights.row(i);
+            if (format == HEIGHT_UNORM16) {
+                for (int j = 0; j < cols; j++)
+                    packed[j] = uint16_t(std::lround(std::clamp(row[j], 0.0f, 1.0f) * 65535.0f));
+                out.write(reinterpret_cast<const char *>(packed.data()), std::streamsize(cols * sizeof(uint16_t)));
+            } else {
+                out.write(reinterpret_cast<const char *>(row), std::streamsize(cols * sizeof(float)));
+            }
+        }
+        if (withRGB) {
+            pad(header.rgbOffset);
+            for (int i = 0; i < rows; i++)
+                out.write(reinterpret_cast<const char *>(rgb.row(i)), std::streamsize(cols * sizeof(glm::u8vec3)));
+        }
+        return bool(out);
+    }
+};
+
+// Writes normalized heights and colors as the .e/.rgb text pair readElevationText/readRGBText read, one grid row
+// per line; %.9g keeps every float exact
+inline bool writeHeightmapText(const std::string &elevationPath, const std::string &rgbPath,
+                               const Grid2D<const float> &heights, const Grid2D<const glm::u8vec3> &colors) {
+    std::FILE *elevation = std::fopen(elevationPath.c_str(), "w");
+    std::FILE *rgb = std::fopen(rgbPath.c_str(), "w");
+    if (elevation == nullptr || rgb == nullptr) {
+        std::cerr << "Error: Could not open " << (elevation == nullptr ? elevationPath : rgbPath) << std::endl;
+        if (elevation != nullptr)
+            std::fclose(elevation);
+        if (rgb != nullptr)
+            std::fclose(rgb);
+        return false;
+    }
+    for (int i = 0; i < heights.rows(); i++) {
+        const float *h = heights.row(i);
+        const glm::u8vec3 *c = colors.row(i);
+        for (int j = 0; j < heights.cols(); j++) {
+            std::fprintf(elevation, j == 0 ? "%.9g" : " %.9g", h[j]);
+            std::fprintf(rgb, j == 0 ? "%.9g %.9g %.9g" : " %.9g %.9g %.9g", c[j].x / 255.0, c[j].y / 255.0,
+                         c[j].z / 255.0);
+        }
+        std::fputc('\n', elevation);
+        std::fputc('\n', rgb);
+    }
+    bool written = std::fclose(elevation) == 0;
+    return std::fclose(rgb) == 0 && written;
+}
+
+inline uint8_t colorToByte(float value) {
+    return uint8_t(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+// Reads a whitespace separated .e file of normalized heights into a rows x cols grid
+inline bool readElevationText(const std::string &path, int rows, int cols, Grid2D<float> &heights) {
+    heights = Grid2D<float>(rows, cols, 0.0f);
+    TextGridResult result = parseTextGrid(path, rows, cols, 1, [&heights](size_t row, size_t index, float value) {
+        heights.row(int(row))[index] = value;
+    });
+
+    // Check if the file is open
+    if (!result.opened) {
+        std::cerr << "Error: Could not open the file " << path << std::endl;
+        return false;
+    }
+    if (result.values != heights.size())
+        std::cerr << "Error: " << path << " holds " << result.values << " heights, expected " << heights.size()
+                  << std::endl;
+    return true;
+}
+
+// Reads a .rgb file of normalized "r g b" triplets into a rows x cols grid of bytes
+inline bool readRGBText(const std::string &path, int rows, int cols, Grid2D<glm::u8vec3> &colors) {
+    colors = Grid2D<glm::u8vec3>(rows, cols, glm::u8vec3(0));
+    TextGridResult result = parseTextGrid(path, rows, cols, 3, [&colors](size_t row, size_t index, float value) {
+        reinterpret_cast<uint8_t *>(colors.row(int(row)))[index] = colorToByte(value);
+    });
+
+    // Check if the file is open
+    if (!result.opened) {
+        std::cerr << "Error: Could not open the file " << path << std::endl;
+        return false;
+    }
+    if (result.values != colors.size() * 3)
+        std::cerr << "Error: " << path << " holds " << result.values / 3 << " colors, expected " << colors.size()
+                  << std::endl;
+    return true;
+}
+
+#endif //RECONSTRUCTION_HEIGHTMAPIO_H
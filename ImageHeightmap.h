@@ -0,0 +1,196 @@
+#ifndef RECONSTRUCTION_IMAGEHEIGHTMAP_H
+#define RECONSTRUCTION_IMAGEHEIGHTMAP_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Grid2D.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include "stb_image.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RECONSTRUCTION_IMAGE_SSE
+#endif
+
+// Turns a photo (anything stb_image decodes: PNG, JPEG, BMP, ...) into a heightmap the way processImage.py
+// does: the image is box-filtered down to the largest size whose mesh stays under a triangle budget,
+// mirrored left to right, and its luminance normalized by the brightest pixel becomes the height; the
+// filtered pixels are the colors.
+
+// processImage.py's default budget
+const int DEFAULT_IMAGE_TRIANGLES = 9000;
+
+// Largest cols (and rows = cols * height / width, rounded down) with 2 * (cols - 1) * (rows - 1) triangles
+// under `maxTriangles`, never larger than the image
+inline void fitImageSize(int width, int height, int maxTriangles, int &rows, int &cols) {
+    auto rowsFor = [&](int c) {
+        return int(double(c) * (double(height) / double(width)));
+    };
+    auto fits = [&](int c) {
+        return 2.0 * double(c - 1) * double(std::max(rowsFor(c) - 1, 0)) < double(maxTriangles);
+    };
+    // the triangle count grows with the width, so the largest fitting width is found by bisection
+    int low = 1, high = width;
+    while (low < high) {
+        int middle = low + (high - low + 1) / 2;
+        if (fits(middle))
+            low = middle;
+        else
+            high = middle - 1;
+    }
+    cols = low;
+    rows = rowsFor(low);
+}
+
+// acc[k] += row[k] * weight for `count` bytes; 8 at a time with AVX2 or SSE2
+inline void accumulateBytes(float *acc, const uint8_t *row, float weight, size_t count) {
+    size_t k = 0;
+#if defined(__AVX2__)
+    const __m256 w = _mm256_set1_ps(weight);
+    for (; k + 8 <= count; k += 8) {
+        __m256 values = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (row + k))));
+        _mm256_storeu_ps(acc + k, _mm256_add_ps(_mm256_loadu_ps(acc + k), _mm256_mul_ps(values, w)));
+    }
+#elif defined(RECONSTRUCTION_IMAGE_SSE)
+    const __m128 w = _mm_set1_ps(weight);
+    const __m128i zero = _mm_setzero_si128();
+    for (; k + 8 <= count; k += 8) {
+        __m128i words = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) (row + k)), zero);
+        __m128 low = _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero));
+        __m128 high = _mm_cvtepi32_ps(_mm_unpackhi_epi16(words, zero));
+        _mm_storeu_ps(acc + k, _mm_add_ps(_mm_loadu_ps(acc + k), _mm_mul_ps(low, w)));
+        _mm_storeu_ps(acc + k + 4, _mm_add_ps(_mm_loadu_ps(acc + k + 4), _mm_mul_ps(high, w)));
+    }
+#endif
+    for (; k < count; k++)
+        acc[k] += float(row[k]) * weight;
+}
+
+// Box filter taps of a downscale from `inSize` to `outSize` samples: output sample k averages the input
+// interval [k * s, (k + 1) * s), s = inSize / outSize, each input sample weighted by its overlap
+struct BoxTaps {
+    std::vector<int> first;       // first input sample of each output sample
+    std::vector<size_t> offset;   // taps of output k are weights[offset[k], offset[k + 1])
+    std::vector<float> weights;
+
+    BoxTaps(int inSize, int outSize) {
+        const double scale = double(inSize) / double(outSize);
+        for (int k = 0; k < outSize; k++) {
+            double start = k * scale, end = std::min((k + 1) * scale, double(inSize));
+            int x = int(start);
+            first.push_back(x);
+            offset.push_back(weights.size());
+            for (; x < end; x++)
+                weights.push_back(float((std::min(x + 1.0, end) - std::max(double(x), start)) / scale));
+        }
+        offset.push_back(weights.size());
+    }
+
+    size_t count(int k) const {
+        return offset[k + 1] - offset[k];
+    }
+};
+
+// Resamples `rgb` (width x height, packed) to the grids' size; rows run in parallel, each accumulating its
+// input rows into one float row (vectorized) before filtering it horizontally
+inline void boxResizeRGB(const uint8_t *rgb, int width, int height, Grid2D<glm::u8vec3> &colors) {
+    const int rows = colors.rows(), cols = colors.cols();
+    const BoxTaps vertical(height, rows), horizontal(width, cols);
+    const size_t rowBytes = size_t(width) * 3;
+    ThreadPool::shared().parallelFor(size_t(rows), 8, [&](size_t firstRow, size_t lastRow) {
+        std::vector<float> acc(rowBytes);
+        for (size_t i = firstRow; i < lastRow; i++) {
+            std::fill(acc.begin(), acc.end(), 0.0f);
+            const float *weights = &vertical.weights[vertical.offset[i]];
+            for (size_t t = 0; t < vertical.count(int(i)); t++)
+                accumulateBytes(acc.data(), rgb + size_t(vertical.first[i] + int(t)) * rowBytes, weights[t], rowBytes);
+            glm::u8vec3 *out = colors.row(int(i));
+            for (int j = 0; j < cols; j++) {
+                const float *w = &horizontal.weights[horizontal.offset[j]];
+                const float *pixel = &acc[size_t(horizontal.first[j]) * 3];
+                float r = 0, g = 0, b = 0;
+                for (size_t t = 0; t < horizontal.count(j); t++, pixel += 3) {
+                    r += pixel[0] * w[t];
+                    g += pixel[1] * w[t];
+                    b += pixel[2] * w[t];
+                }
+                out[j] = glm::u8vec3(uint8_t(std::min(r + 0.5f, 255.0f)), uint8_t(std::min(g + 0.5f, 255.0f)),
+                                     uint8_t(std::min(b + 0.5f, 255.0f)));
+            }
+        }
+    });
+}
+
+// Decodes `path` and builds the normalized heights and the colors of the resized, mirrored image
+inline bool loadImageHeightmap(const std::string &path, int maxTriangles, Grid2D<float> &heights,
+                               Grid2D<glm::u8vec3> &colors) {
+    TRACE_ZONE("loadImageHeightmap");
+    int width, height, channels;
+    stbi_uc *pixels;
+    {
+        Trace::Zone zone("stbi_load", path.c_str());
+        pixels = stbi_load(path.c_str(), &width, &height, &channels, 3);
+    }
+    if (pixels == nullptr) {
+        std::cerr << "Error: Could not decode " << path << ": " << stbi_failure_reason() << std::endl;
+        return false;
+    }
+    int rows, cols;
+    fitImageSize(width, height, maxTriangles, rows, cols);
+    if (rows < 2 || cols < 2) {
+        std::cerr << "Error: " << maxTriangles << " triangles are too few for a " << width << "x" << height
+                  << " image" << std::endl;
+        stbi_image_free(pixels);
+        return false;
+    }
+
+    Grid2D<glm::u8vec3> resized(rows, cols);
+    {
+        TRACE_ZONE("boxResizeRGB");
+        boxResizeRGB(pixels, width, height, resized);
+    }
+    stbi_image_free(pixels);
+
+    // mirror left to right and take the ITU-R 601 luma (PIL's "L" conversion)
+    colors = Grid2D<glm::u8vec3>(rows, cols);
+    heights = Grid2D<float>(rows, cols, 0.0f);
+    std::vector<uint8_t> rowMax(size_t(rows), 0);
+    ThreadPool::shared().parallelFor(size_t(rows), 16, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+            const glm::u8vec3 *in = resized.row(int(i));
+            glm::u8vec3 *out = colors.row(int(i));
+            float *h = heights.row(int(i));
+            for (int j = 0; j < cols; j++) {
+                glm::u8vec3 c = in[cols - 1 - j];
+                out[j] = c;
+                uint32_t luma = (uint32_t(c.x) * 19595 + uint32_t(c.y) * 38470 + uint32_t(c.z) * 7471 + 0x8000) >> 16;
+                h[j] = float(luma);
+                rowMax[i] = std::max(rowMax[i], uint8_t(luma));
+            }
+        }
+    });
+    uint8_t brightest = *std::max_element(rowMax.begin(), rowMax.end());
+    if (brightest > 0) {
+        const float inverse = 1.0f / float(brightest);
+        ThreadPool::shared().parallelFor(size_t(rows), 64, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++) {
+                float *h = heights.row(int(i));
+                for (int j = 0; j < cols; j++)
+                    h[j] *= inverse;
+            }
+        });
+    }
+    return true;
+}
+
+#endif //RECONSTRUCTION_IMAGEHEIGHTMAP_H
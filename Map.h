@@ -6,11 +6,25 @@
 #define RECONSTRUCTION_MAP_H
 
 #include <utility>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <mutex>
 #include <vector>
 #include <iostream>
-#include <sstream>
-#include <fstream>
-#include "Triangle.h"
+#include "DisplacedTerrain.h"
+#include "Grid2D.h"
+#include "HeightmapIO.h"
+#include "MeshArena.h"
+#include "NormalKernel.h"
+#include "TerrainMesh.h"
+#include "TerrainLod.h"
+#include "TerrainOcclusion.h"
+#include "TerrainQuadtree.h"
+#include "TerrainRtin.h"
+#include "ThreadPool.h"
+#include "Trace.h"
 
 class Map {
     int rows, cols;
@@ -18,11 +32,57 @@ class Map {
 
     std::string eFile;
     std::string rgbFile;
-    std::vector<std::vector<double>> elevationMatrix;
-    std::vector<std::vector<glm::vec3>> rgbMatrix;
+    std::string binaryFile;
+    bool in_memory = false;
+
+    // Heights are normalized and scaled to [min_height, max_height] on use. Both grids are either
+    // owned (text input) or views straight into a mapped .hmap file.
+    Grid2D<const float> elevationGrid;
+    Grid2D<const glm::u8vec3> rgbGrid;
+    HeightmapFile heightmapFile;
+
+    bool triangle_strips = false;
+    int chunk_size = 64;
+    TerrainQuadtree quadtree;
+    std::vector<ChunkRun> visibleRuns;
+    std::vector<TerrainMesh::Range> visibleRanges;
+    MeshArena arena;
+    TerrainMesh mesh;
+    bool gpu_displacement = false;
+    DisplacedTerrain displaced;
+    bool level_of_detail = false;
+    float lod_pixel_error = 2.0f;
+    TerrainLod lod;
+    std::vector<GLuint> lodIndices;
+    std::vector<ChunkRun> lodRuns; // visible runs lodIndices was built for
+    bool lodDirty = true;
+    bool simplify = false;
+    double simplification_error = 0.5;
+    TerrainRtin rtin;
+    bool occlusion_culling = false;
+    TerrainOcclusion occlusion;
+    std::vector<std::pair<float, int>> occluders; // (distance, chunk) of the visible chunks
+    std::vector<ChunkRun> unoccludedRuns;
+
+    std::function<void(size_t, size_t)> progress;
+    std::atomic<size_t> progressRows{0};
+    size_t progressReported = 0;
+    std::mutex progressMutex;
+public:
+    // What the last display() call submitted
+    struct FrameStats {
+        size_t chunks = 0;
+        size_t visibleChunks = 0;
+        size_t frustumCulled = 0;
+        size_t occlusionCulled = 0;
+        size_t draws = 0;       // ranges drawn
+        size_t drawCalls = 0;   // GL calls they were submitted in
+        size_t triangles = 0;
+    };
+
+private:
+    FrameStats stats;
 
-    std::vector<std::pair<std::vector<glm::vec3>, glm::vec3>> triangle_metadata;
-    std::vector<Triangle> triangles;
 public:
     Map(int rows_, int cols_, double minh, double maxh, std::string elevationFilename, std::string rgbFilename) : rows(
             rows_), cols(cols_), min_height(minh), max_height(maxh), eFile(std::move(elevationFilename)),
@@ -30,116 +90,586 @@ public:
                                                                                                                           rgbFilename)) {}
 
     void readElevation() {
-        std::ifstream file(eFile);
+        TRACE_ZONE("Map::readElevation");
+        Grid2D<float> heights;
+        if (readElevationText(eFile, rows, cols, heights))
+            elevationGrid = heights;
+    }
+
+    void readRGB() {
+        TRACE_ZONE("Map::readRGB");
+        Grid2D<glm::u8vec3> colors;
+        if (readRGBText(rgbFile, rows, cols, colors))
+            rgbGrid = colors;
+    }
 
-        // Check if the file is open
-        if (!file.is_open()) {
-            std::cerr << "Error: Could not open the file " << eFile << std::endl;
+    // Loads a .hmap file in place of the text files; float32 heights and colors are used zero-copy
+    // from the mapping, unorm16 heights are expanded once.
+    void readBinary() {
+        TRACE_ZONE("Map::readBinary");
+        if (!heightmapFile.open(binaryFile))
             return;
+        const HeightmapHeader &header = heightmapFile.header();
+        if (int(header.rows) != rows || int(header.cols) != cols)
+            std::cerr << "Warning: " << binaryFile << " is " << header.rows << "x" << header.cols
+                      << ", metadata says " << rows << "x" << cols << std::endl;
+        rows = int(header.rows);
+        cols = int(header.cols);
+        min_height = header.minHeight;
+        max_height = header.maxHeight;
+
+        if (header.format == HEIGHT_FLOAT32) {
+            elevationGrid = heightmapFile.heights32();
+        } else {
+            Grid2D<const uint16_t> packed = heightmapFile.heights16();
+            Grid2D<float> heights(rows, cols);
+            for (int i = 0; i < rows; i++) {
+                const uint16_t *in = packed.row(i);
+                float *out = heights.row(i);
+                for (int j = 0; j < cols; j++)
+                    out[j] = float(in[j]) * (1.0f / 65535.0f);
+            }
+            elevationGrid = heights;
+        }
+
+        if (heightmapFile.hasRGB())
+            rgbGrid = heightmapFile.rgb();
+        else
+            rgbGrid = Grid2D<glm::u8vec3>(rows, cols, glm::u8vec3(255));
+    }
+
+    void use_binary(std::string binaryFilename) {
+        binaryFile = std::move(binaryFilename);
+    }
+
+    // Uses grids that are already in memory (e.g. from loadImageHeightmap) instead of reading files; the
+    // map takes their size
+    void use_heightmap(const Grid2D<const float> &heights, const Grid2D<const glm::u8vec3> &colors) {
+        elevationGrid = heights;
+        rgbGrid = colors;
+        rows = heights.rows();
+        cols = heights.cols();
+        in_memory = true;
+    }
+
+    float elevation(int i, int j) const {
+        return float(elevationGrid(i, j) * (max_height - min_height) + min_height);
+    }
+
+    glm::vec3 color(int i, int j) const {
+        return glm::vec3(rgbGrid(i, j)) / 255.0f;
+    }
+
+    void change_proximity(double scale_factor) {
+        this->scale_factor = scale_factor;
+    }
+
+    static glm::vec3 calculateNormal(const glm::vec3 &vertex1, const glm::vec3 &vertex2, const glm::vec3 &vertex3) {
+        glm::vec3 edge1 = vertex2 - vertex1;
+        glm::vec3 edge2 = vertex3 - vertex1;
+        glm::vec3 normal = glm::normalize(glm::cross(edge1, edge2));
+        return normal;
+    }
+
+    void use_triangle_strips(bool strips) {
+        this->triangle_strips = strips;
+    }
+
+    size_t vertexIndex(int i, int j) const {
+        return size_t(i) * cols + j;
+    }
+
+    glm::vec3 gridPosition(int i, int j, float normalizedHeight) const {
+        return glm::vec3(float(i * scale_factor), float(normalizedHeight * (max_height - min_height) + min_height),
+                         float(j * scale_factor));
+    }
+
+    // Bumps the shared row counter and reports it; calls are serialized and never go backwards
+    void reportProgress(size_t rowsDone) {
+        size_t done = progressRows.fetch_add(rowsDone) + rowsDone;
+        if (progress) {
+            std::lock_guard<std::mutex> lock(progressMutex);
+            if (done > progressReported) {
+                progressReported = done;
+                progress(done, size_t(rows));
+            }
         }
+    }
+
+    // One shared vertex per elevation sample, written once in its final form. Row bands are built in
+    // parallel and every vertex lands at its grid index; smooth normals come from central differences
+    // of the neighbouring rows (NormalKernel.h), so no two threads write the same vertex.
+    void buildVertices(TerrainMesh::Vertex *vertices) {
+        TRACE_ZONE("Map::buildVertices");
+        const size_t rowsPerTask = std::max<size_t>(1, size_t(16384) / size_t(cols));
+        const float heightScale = float(max_height - min_height);
+        const bool morphed = uses_lod();
+        ThreadPool::shared().parallelFor(size_t(rows), rowsPerTask, [&](size_t first, size_t last) {
+            std::vector<glm::vec3> normals(cols);
+            for (int i = int(first); i < int(last); ++i) {
+                const float *heights = elevationGrid.row(i);
+                const glm::u8vec3 *colors = rgbGrid.row(i);
+                int above = std::max(i - 1, 0), below = std::min(i + 1, rows - 1);
+                NormalRow normalRow = makeNormalRow(elevationGrid.row(above), heights, elevationGrid.row(below),
+                                                    below - above, cols, heightScale, float(scale_factor));
+                heightfieldNormalsRow(normalRow, normals.data());
+                TerrainMesh::Vertex *row = vertices + vertexIndex(i, 0);
+                for (int j = 0; j < cols; ++j) {
+                    // only terrain_lod.vs reads the morph height and level
+                    glm::vec2 morph = morphed ? lod.morph(elevationGrid, i, j) : glm::vec2(heights[j], 0.0f);
+                    row[j].height = glm::u16vec2(TerrainMesh::packHeight(heights[j]),
+                                                 TerrainMesh::packHeight(morph.x));
+                    row[j].normal = packOctahedral16(normals[j]);
+                    row[j].color = glm::u8vec4(colors[j], uint8_t(morph.y));
+                }
+            }
+            reportProgress(last - first);
+        });
+    }
 
+    void setGridUniforms(Shader &sh) const {
+        TerrainMesh::setGrid(sh, 0, 0, cols, rows - 1, cols - 1, float(scale_factor), float(min_height),
+                             float(max_height));
+    }
 
-        std::string line;
-        while (std::getline(file, line)) {
-            std::istringstream iss(line);
-            std::vector<double> row;
+    // Quads per chunk side; chunks are the unit of frustum culling
+    void set_chunk_size(int quads) {
+        this->chunk_size = std::max(quads, 1);
+    }
 
-            double value;
-            while (iss >> value) {
-                value = (value * (max_height - min_height)) + min_height;
-                row.push_back(value);
+    // Splits the grid into chunks and finds each chunk's normalized height range (and LOD or RTIN errors)
+    void buildChunks() {
+        TRACE_ZONE("Map::buildChunks");
+        quadtree.build(rows, cols, level_of_detail ? TerrainLod::floorPowerOfTwo(chunk_size) : chunk_size);
+        std::vector<TerrainChunk> &chunks = quadtree.chunks;
+        ThreadPool::shared().parallelFor(chunks.size(), 1, [&](size_t first, size_t last) {
+            for (size_t c = first; c < last; c++) {
+                TerrainChunk &chunk = chunks[c];
+                float lo = elevationGrid(chunk.row, chunk.col), hi = lo;
+                for (int i = chunk.row; i <= chunk.row + chunk.rows; i++) {
+                    const float *heights = elevationGrid.row(i);
+                    for (int j = chunk.col; j <= chunk.col + chunk.cols; j++) {
+                        lo = std::min(lo, heights[j]);
+                        hi = std::max(hi, heights[j]);
+                    }
+                }
+                chunk.heightMin = lo;
+                chunk.heightMax = hi;
             }
+        });
+        updateChunkBounds();
+        if (level_of_detail)
+            lod.build(quadtree, elevationGrid);
+        if (uses_simplification())
+            rtin.build(quadtree, elevationGrid);
+        if (occlusion_culling)
+            occlusion.build(elevationGrid, chunks);
+        else
+            occlusion = TerrainOcclusion(); // built on first use
+    }
 
-            elevationMatrix.push_back(row);
+    // Model-space chunk boxes for the current spacing and height range
+    void updateChunkBounds() {
+        for (TerrainChunk &chunk: quadtree.chunks) {
+            glm::vec3 a = gridPosition(chunk.row, chunk.col, chunk.heightMin);
+            glm::vec3 b = gridPosition(chunk.row + chunk.rows, chunk.col + chunk.cols, chunk.heightMax);
+            chunk.boundsMin = glm::min(a, b);
+            chunk.boundsMax = glm::max(a, b);
         }
+        quadtree.updateBounds();
+    }
 
-        file.close();
+    size_t chunkIndexCount(const TerrainChunk &chunk) const {
+        return triangle_strips ? size_t(chunk.rows) * (2 * (chunk.cols + 1) + 1) : size_t(chunk.rows) * chunk.cols * 6;
     }
 
-    void readRGB() {
-        std::ifstream file(rgbFile);
-        // Check if the file is open
-        if (!file.is_open()) {
-            std::cerr << "Error: Could not open the file " << rgbFile << std::endl;
+    size_t chunkTriangleCount(const TerrainChunk &chunk) const {
+        return uses_simplification() ? chunk.indexCount / 3 : size_t(chunk.rows) * chunk.cols * 2;
+    }
+
+    // Lays the chunks out one after another in quadtree order and returns the total index count
+    size_t layoutIndices() {
+        std::vector<TerrainChunk> &chunks = quadtree.chunks;
+        if (uses_simplification()) {
+            const float threshold = normalizedMaxError();
+            ThreadPool::shared().parallelFor(chunks.size(), 1, [&](size_t first, size_t last) {
+                for (size_t c = first; c < last; c++)
+                    chunks[c].indexCount = rtin.indexCount(c, threshold);
+            });
+        } else {
+            for (TerrainChunk &chunk: chunks)
+                chunk.indexCount = chunkIndexCount(chunk);
+        }
+        size_t offset = 0;
+        for (TerrainChunk &chunk: chunks) {
+            chunk.indexOffset = offset;
+            offset += chunk.indexCount;
+        }
+        return offset;
+    }
+
+    // Indices are chunk-major, so every chunk (and every quadtree node) is a contiguous range; each chunk owns a
+    // fixed slice of the buffer and chunks are written in parallel
+    template<typename Index>
+    void buildIndices(Index *indices, Index restart) const {
+        TRACE_ZONE("Map::buildIndices");
+        const std::vector<TerrainChunk> &chunks = quadtree.chunks;
+        const bool simplified = uses_simplification();
+        const float threshold = normalizedMaxError();
+        ThreadPool::shared().parallelFor(chunks.size(), 1, [&](size_t first, size_t last) {
+            for (size_t c = first; c < last; c++) {
+                const TerrainChunk &chunk = chunks[c];
+                Index *out = indices + chunk.indexOffset;
+                if (simplified) {
+                    rtin.buildIndices(c, threshold, out);
+                    continue;
+                }
+                for (int i = chunk.row; i < chunk.row + chunk.rows; ++i) {
+                    if (triangle_strips) {
+                        // One strip per pair of rows, separated by the primitive restart index
+                        for (int j = chunk.col; j <= chunk.col + chunk.cols; ++j) {
+                            *out++ = Index(vertexIndex(i, j));
+                            *out++ = Index(vertexIndex(i + 1, j));
+                        }
+                        *out++ = restart;
+                    } else {
+                        for (int j = chunk.col; j < chunk.col + chunk.cols; ++j) {
+                            out[0] = Index(vertexIndex(i, j + 1));
+                            out[1] = Index(vertexIndex(i, j));
+                            out[2] = Index(vertexIndex(i + 1, j));
+                            out[3] = Index(vertexIndex(i + 1, j + 1));
+                            out[4] = Index(vertexIndex(i, j + 1));
+                            out[5] = Index(vertexIndex(i + 1, j));
+                            out += 6;
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    // Called from the worker threads with the number of rows meshed so far; calls never overlap
+    void set_progress_callback(std::function<void(size_t, size_t)> callback) {
+        progress = std::move(callback);
+    }
+
+    // Heights stay on the GPU and the vertex shader displaces a generated grid (needs the
+    // terrain_displacement.vs shader); otherwise the mesh is built on the CPU
+    void use_gpu_displacement(bool displacement) {
+        this->gpu_displacement = displacement;
+    }
+
+    bool uses_gpu_displacement() const {
+        return gpu_displacement;
+    }
+
+    // Draws distant chunks with fewer triangles (TerrainLod.h; needs the terrain_lod.vs shader). The chunk size
+    // is rounded down to a power of two and the mesh is always drawn as triangles. Ignored with GPU displacement.
+    void use_lod(bool enabled) {
+        this->level_of_detail = enabled;
+    }
+
+    bool uses_lod() const {
+        return level_of_detail && !gpu_displacement;
+    }
+
+    // Largest on-screen height error, in pixels, a chunk may have before a finer level is used
+    void set_lod_error(float pixels) {
+        this->lod_pixel_error = std::max(pixels, 0.01f);
+    }
+
+    float lod_error() const {
+        return lod_pixel_error;
+    }
+
+    // Replaces the full grid by an adaptive triangulation (TerrainRtin.h) within max_error() of every sample.
+    // Drawn as triangles; ignored with GPU displacement or LOD.
+    void use_simplification(bool enabled) {
+        this->simplify = enabled;
+    }
+
+    bool uses_simplification() const {
+        return simplify && !gpu_displacement && !uses_lod();
+    }
+
+    // Largest vertical distance, in world units, between the simplified mesh and the heightmap; changing it
+    // only re-extracts the indices
+    void set_max_error(double error) {
+        error = std::max(error, 0.0);
+        if (error == simplification_error)
             return;
+        simplification_error = error;
+        if (uses_simplification() && mesh.indexCount > 0)
+            updateIndices();
+    }
+
+    double max_error() const {
+        return simplification_error;
+    }
+
+    float normalizedMaxError() const {
+        double range = std::abs(max_height - min_height);
+        return range > 0 ? float(simplification_error / range) : std::numeric_limits<float>::max();
+    }
+
+    // Skips the chunks that nearer terrain hides (TerrainOcclusion.h), tested on the CPU after frustum culling.
+    // Only used while the eye is above the terrain.
+    void use_occlusion_culling(bool enabled) {
+        this->occlusion_culling = enabled;
+    }
+
+    bool uses_occlusion_culling() const {
+        return occlusion_culling;
+    }
+
+    // How far, normalized, the drawn surface of chunk `c` may dip below its samples
+    float surfaceSlack(size_t c) const {
+        if (uses_lod())
+            return lod.drawnError(quadtree.chunks, c);
+        if (uses_simplification())
+            return normalizedMaxError();
+        return 0.0f;
+    }
+
+    // Whether the model-space eye is above the drawn terrain under it
+    bool eyeAboveTerrain(const glm::vec3 &eye) const {
+        if (eye.y > float(std::max(min_height, max_height)))
+            return true;
+        const float i = eye.x / float(scale_factor), j = eye.z / float(scale_factor);
+        if (!(i >= 0.0f && j >= 0.0f && i <= float(rows - 1) && j <= float(cols - 1)))
+            return false;
+        const int i0 = std::min(int(i), rows - 2), j0 = std::min(int(j), cols - 2);
+        float top = std::max({elevation(i0, j0), elevation(i0, j0 + 1), elevation(i0 + 1, j0),
+                              elevation(i0 + 1, j0 + 1)});
+        const std::vector<TerrainChunk> &chunks = quadtree.chunks;
+        for (size_t c = 0; c < chunks.size(); c++) {
+            const TerrainChunk &chunk = chunks[c];
+            if (i0 >= chunk.row && i0 < chunk.row + chunk.rows && j0 >= chunk.col && j0 < chunk.col + chunk.cols) {
+                top += float(std::abs(max_height - min_height)) * surfaceSlack(c);
+                break;
+            }
         }
+        return eye.y > top;
+    }
 
-        std::string line;
-        while (std::getline(file, line)) {
-            std::istringstream iss(line);
-            std::vector<glm::vec3> row;
+    // Rasterizes the nearest visible chunks as occluders and drops the visible chunks behind them
+    void cullOccluded(const glm::mat4 &mvp, float aspect, const glm::vec3 &eye) {
+        TRACE_ZONE("Map::cullOccluded");
+        const std::vector<TerrainChunk> &chunks = quadtree.chunks;
+        if (occlusion.empty())
+            occlusion.build(elevationGrid, chunks);
+        if (!eyeAboveTerrain(eye))
+            return;
 
-            glm::vec3 rgbValues;
-            while (iss >> rgbValues.r >> rgbValues.g >> rgbValues.b) {
-                row.push_back(rgbValues);
+        occluders.clear();
+        for (const ChunkRun &run: visibleRuns) {
+            for (int c = run.first; c < run.first + run.count; c++) {
+                const TerrainChunk &chunk = chunks[c];
+                float distance = glm::length(glm::max(glm::max(chunk.boundsMin - eye, eye - chunk.boundsMax),
+                                                      glm::vec3(0.0f)));
+                occluders.push_back({distance, c});
             }
+        }
+        const size_t count = std::min(occluders.size(), size_t(occlusion.maxOccluders));
+        std::partial_sort(occluders.begin(), occluders.begin() + count, occluders.end());
+        occlusion.begin(mvp, aspect, float(scale_factor), float(max_height - min_height), float(min_height));
+        for (size_t k = 0; k < count; k++)
+            occlusion.addOccluder(size_t(occluders[k].second), eye, surfaceSlack(size_t(occluders[k].second)));
+        occlusion.finish();
 
-            if (!row.empty()) {
-                rgbMatrix.push_back(row);
-            } else {
-                std::cerr << "Error: Invalid number of RGB values in line" << std::endl;
+        unoccludedRuns.clear();
+        for (const ChunkRun &run: visibleRuns) {
+            for (int c = run.first; c < run.first + run.count; c++) {
+                if (occlusion.occluded(chunks[c].boundsMin, chunks[c].boundsMax)) {
+                    stats.occlusionCulled++;
+                } else if (!unoccludedRuns.empty() &&
+                           unoccludedRuns.back().first + unoccludedRuns.back().count == c) {
+                    unoccludedRuns.back().count++;
+                } else {
+                    unoccludedRuns.push_back({c, 1});
+                }
             }
         }
+        visibleRuns.swap(unoccludedRuns);
+    }
 
-        file.close();
+    // World height of normalized 0 and 1: the constructor's range, replaced by a .hmap header's in setup()
+    double min_elevation() const {
+        return min_height;
+    }
 
+    double max_elevation() const {
+        return max_height;
     }
 
-    void change_proximity(double scale_factor) {
-        this->scale_factor = scale_factor;
+    // New world range for the normalized heights: a uniform change with GPU displacement, a mesh rebuild otherwise
+    void set_height_range(double minh, double maxh) {
+        if (minh == min_height && maxh == max_height)
+            return;
+        min_height = minh;
+        max_height = maxh;
+        updateChunkBounds();
+        // the LOD mesh starts without indices, so test for the mesh itself
+        if (!gpu_displacement && mesh.vao != 0)
+            buildMesh();
     }
 
-    static glm::vec3 calculateNormal(const glm::vec3 &vertex1, const glm::vec3 &vertex2, const glm::vec3 &vertex3) {
-        glm::vec3 edge1 = vertex2 - vertex1;
-        glm::vec3 edge2 = vertex3 - vertex1;
-        glm::vec3 normal = glm::normalize(glm::cross(edge1, edge2));
-        return normal;
+    void buildMesh() {
+        TRACE_ZONE("Map::buildMesh");
+        progressRows = 0;
+        progressReported = 0;
+        const size_t vertexCount = size_t(rows) * cols;
+        const size_t indexCount = layoutIndices();
+        if (uses_lod()) {
+            // the indices are rebuilt from the selected levels every time they change
+            arena.reserve<TerrainMesh::Vertex, GLuint>(vertexCount, 0);
+            buildVertices(arena.vertices<TerrainMesh::Vertex>());
+            mesh.setup(arena.vertices<TerrainMesh::Vertex>(), vertexCount, nullptr, 0, GL_UNSIGNED_INT, GL_TRIANGLES);
+            lod.setup(quadtree.chunks);
+            lodDirty = true;
+            return;
+        }
+        const GLenum mode = triangle_strips && !uses_simplification() ? GL_TRIANGLE_STRIP : GL_TRIANGLES;
+        // Indices are built directly in the narrowest type the vertex count allows
+        if (vertexCount < 0xFFFF) {
+            arena.reserve<TerrainMesh::Vertex, GLushort>(vertexCount, indexCount);
+            buildIndices(arena.indices<GLushort>(), GLushort(0xFFFF));
+        } else {
+            arena.reserve<TerrainMesh::Vertex, GLuint>(vertexCount, indexCount);
+            buildIndices(arena.indices<GLuint>(), TerrainMesh::RESTART_INDEX);
+        }
+        buildVertices(arena.vertices<TerrainMesh::Vertex>());
+        mesh.setup(arena.vertices<TerrainMesh::Vertex>(), vertexCount, arena.indices<void>(), indexCount,
+                   vertexCount < 0xFFFF ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, mode);
+    }
+
+    // Rebuilds and re-uploads the indices only. The arena may be reallocated, so its vertices are not kept.
+    void updateIndices() {
+        TRACE_ZONE("Map::updateIndices");
+        const size_t vertexCount = size_t(rows) * cols;
+        const size_t indexCount = layoutIndices();
+        if (vertexCount < 0xFFFF) {
+            arena.reserve<TerrainMesh::Vertex, GLushort>(vertexCount, indexCount);
+            buildIndices(arena.indices<GLushort>(), GLushort(0xFFFF));
+        } else {
+            arena.reserve<TerrainMesh::Vertex, GLuint>(vertexCount, indexCount);
+            buildIndices(arena.indices<GLuint>(), TerrainMesh::RESTART_INDEX);
+        }
+        mesh.updateIndices(arena.indices<void>(), indexCount);
     }
 
     void setup() {
-        readElevation();
-        readRGB();
-
-        for (int i = 0; i < rows - 1; ++i) {
-            for (int j = 0; j < cols - 1; ++j) {
-                glm::vec3 vertex1(double(i) * scale_factor, elevationMatrix[i][j], double(j) * scale_factor);
-                glm::vec3 vertex2(double(i + 1) * scale_factor, elevationMatrix[i + 1][j], double(j) * scale_factor);
-                glm::vec3 vertex3(double(i) * scale_factor, elevationMatrix[i][j + 1], double(j + 1) * scale_factor);
-                glm::vec3 vertex4(double(i + 1) * scale_factor, elevationMatrix[i + 1][j + 1],
-                                  double(j + 1) * scale_factor);
-
-                auto nt1 = calculateNormal(vertex3, vertex1, vertex2);
-                auto nt2 = calculateNormal(vertex4, vertex3, vertex2);
-
-
-                std::vector<glm::vec3> triangle1 = {vertex3, -nt1,
-                                                    vertex1, -nt1,
-                                                    vertex2, -nt1};
-                std::vector<glm::vec3> triangle2 = {vertex4, -nt2,
-                                                    vertex3, -nt2,
-                                                    vertex2, -nt2};
-                double p1x = (rgbMatrix[i][j].x + rgbMatrix[i + 1][j].x + rgbMatrix[i][j + 1].x) / 3;
-                double p1y = (rgbMatrix[i][j].y + rgbMatrix[i + 1][j].y + rgbMatrix[i][j + 1].y) / 3;
-                double p1z = (rgbMatrix[i][j].z + rgbMatrix[i + 1][j].z + rgbMatrix[i][j + 1].z) / 3;
-
-                double p2x = (rgbMatrix[i + 1][j + 1].x + rgbMatrix[i + 1][j].x + rgbMatrix[i][j + 1].x) / 3;
-                double p2y = (rgbMatrix[i + 1][j + 1].y + rgbMatrix[i + 1][j].y + rgbMatrix[i][j + 1].y) / 3;
-                double p2z = (rgbMatrix[i + 1][j + 1].z + rgbMatrix[i + 1][j].z + rgbMatrix[i][j + 1].z) / 3;
-                triangle_metadata.emplace_back(triangle1, glm::vec3(p1x, p1y, p1z));
-                triangle_metadata.emplace_back(triangle2, glm::vec3(p2x, p2y, p2z));
+        TRACE_ZONE("Map::setup");
+        if (in_memory) {
+            // grids given by use_heightmap()
+        } else if (!binaryFile.empty()) {
+            readBinary();
+        } else {
+            readElevation();
+            readRGB();
+        }
+        if (elevationGrid.empty() || rgbGrid.empty() || rows < 2 || cols < 2)
+            return;
+
+        buildChunks();
+        if (gpu_displacement)
+            displaced.setup(elevationGrid, rgbGrid, quadtree.chunks);
+        else
+            buildMesh();
+    }
+
+    // Draws the chunks whose boxes touch the view frustum and, with occlusion culling, are not hidden by nearer
+    // terrain; `viewportHeight` (pixels) sizes the LOD error
+    void display(Shader &sh, float cambio_escala, const glm::mat4 &projection, const glm::mat4 &view,
+                 int viewportHeight) {
+        glm::mat4 model = glm::scale(glm::mat4(1.0), glm::vec3(cambio_escala));
+        Frustum frustum(projection * view * model);
+        const std::vector<TerrainChunk> &chunks = quadtree.chunks;
+        stats = FrameStats();
+        stats.chunks = chunks.size();
+
+        // neighbouring chunks are neighbours in the index buffer too, so touching runs are merged
+        visibleRuns.clear();
+        quadtree.cull(frustum, [this](int first, int count) {
+            if (!visibleRuns.empty() && visibleRuns.back().first + visibleRuns.back().count == first)
+                visibleRuns.back().count += count;
+            else
+                visibleRuns.push_back({first, count});
+        });
+        stats.frustumCulled = chunks.size();
+        for (const ChunkRun &run: visibleRuns)
+            stats.frustumCulled -= size_t(run.count);
+
+        // the model matrix only scales, so the model-space eye is the world-space one divided by the scale
+        glm::vec3 eye = glm::vec3(glm::inverse(view)[3]) / cambio_escala;
+        // LOD levels are picked first: they decide how far below its samples a chunk's surface may be
+        bool levelsChanged = false;
+        if (uses_lod())
+            levelsChanged = lod.select(chunks, eye, float(max_height - min_height),
+                                       projection[1][1] * float(viewportHeight) * 0.5f, lod_pixel_error);
+        if (occlusion_culling)
+            cullOccluded(projection * view * model, projection[1][1] / projection[0][0], eye);
+
+        for (const ChunkRun &run: visibleRuns) {
+            stats.visibleChunks += size_t(run.count);
+            for (int c = run.first; c < run.first + run.count; c++)
+                stats.triangles += chunkTriangleCount(chunks[c]);
+        }
+
+        if (gpu_displacement) {
+            displaced.display(sh, cambio_escala, float(min_height), float(max_height), float(scale_factor), chunks,
+                              visibleRuns.data(), visibleRuns.size());
+            stats.draws = stats.visibleChunks;
+            stats.drawCalls = displaced.batched ? (stats.draws > 0 ? 1 : 0) : stats.draws;
+        } else if (uses_lod()) {
+            displayLod(sh, cambio_escala, projection, eye, viewportHeight, levelsChanged);
+        } else {
+            visibleRanges.clear();
+            for (const ChunkRun &run: visibleRuns) {
+                const TerrainChunk &last = chunks[run.first + run.count - 1];
+                size_t first = chunks[run.first].indexOffset;
+                visibleRanges.push_back({first, last.indexOffset + last.indexCount - first});
             }
+            setGridUniforms(sh);
+            mesh.display(sh, cambio_escala, visibleRanges.data(), visibleRanges.size());
+            stats.draws = visibleRanges.size();
+            stats.drawCalls = stats.draws > 0 ? 1 : 0;
         }
-        int x = 0;
-        for (const auto &triangle: triangle_metadata) {
-            std::cout << x++ << std::endl;
-            Triangle t1(triangle.first, triangle.second);
-            triangles.emplace_back(t1);
+    }
+
+    // `eye` is in model space; `levelsChanged` tells whether display()'s lod.select() changed any level
+    void displayLod(Shader &sh, float cambio_escala, const glm::mat4 &projection, const glm::vec3 &eye,
+                    int viewportHeight, bool levelsChanged) {
+        const std::vector<TerrainChunk> &chunks = quadtree.chunks;
+        float pixelsPerUnit = projection[1][1] * float(viewportHeight) * 0.5f;
+        float heightScale = float(max_height - min_height);
+
+        bool sameRuns = std::equal(visibleRuns.begin(), visibleRuns.end(), lodRuns.begin(), lodRuns.end(),
+                                   [](const ChunkRun &a, const ChunkRun &b) {
+                                       return a.first == b.first && a.count == b.count;
+                                   });
+        if (levelsChanged || lodDirty || !sameRuns) {
+            TRACE_ZONE("Map::emitLod");
+            lodIndices.clear();
+            for (const ChunkRun &run: visibleRuns)
+                for (int c = run.first; c < run.first + run.count; c++)
+                    lod.emitChunk(chunks, size_t(c), lodIndices);
+            mesh.updateIndices(lodIndices.data(), lodIndices.size());
+            lodRuns = visibleRuns;
+            lodDirty = false;
         }
+
+        lod.bindMorph(sh, heightScale, pixelsPerUnit, lod_pixel_error);
+        sh.setVec3("eyePos", eye);
+        setGridUniforms(sh);
+        mesh.display(sh, cambio_escala);
+        lod.unbindMorph();
+        stats.draws = stats.drawCalls = 1;
+        stats.triangles = lodIndices.size() / 3;
     }
 
-    void display(Shader &sh, float cambio_escala) {
-        for (auto &triangle: triangles)
-            triangle.display(sh, cambio_escala);
+    const FrameStats &frame_stats() const {
+        return stats;
     }
 };
 
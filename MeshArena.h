@@ -0,0 +1,63 @@
+#ifndef RECONSTRUCTION_MESHARENA_H
+#define RECONSTRUCTION_MESHARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+
+// One reserved block holding a mesh's vertices followed by its indices. The block only grows, so
+// rebuilding a mesh of the same size reuses it without touching the allocator.
+class MeshArena {
+    struct AlignedDelete {
+        void operator()(unsigned char *p) const {
+            ::operator delete(p, std::align_val_t(ALIGNMENT));
+        }
+    };
+
+    std::unique_ptr<unsigned char, AlignedDelete> block;
+    size_t capacity = 0;
+    size_t vertexBytes = 0;
+    size_t indexOffset = 0;
+    size_t indexBytes = 0;
+
+public:
+    static const size_t ALIGNMENT = 64;
+
+    // Lays out `vertexCount` vertices and `indexCount` indices, growing the block when needed
+    template<typename Vertex, typename Index>
+    void reserve(size_t vertexCount, size_t indexCount) {
+        vertexBytes = vertexCount * sizeof(Vertex);
+        indexOffset = (vertexBytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        indexBytes = indexCount * sizeof(Index);
+        size_t needed = indexOffset + indexBytes;
+        if (needed > capacity) {
+            block.reset(static_cast<unsigned char *>(::operator new(needed, std::align_val_t(ALIGNMENT))));
+            capacity = needed;
+        }
+    }
+
+    template<typename Vertex>
+    Vertex *vertices() const {
+        return reinterpret_cast<Vertex *>(block.get());
+    }
+
+    template<typename Index>
+    Index *indices() const {
+        return reinterpret_cast<Index *>(block.get() + indexOffset);
+    }
+
+    size_t verticesSize() const {
+        return vertexBytes;
+    }
+
+    size_t indicesSize() const {
+        return indexBytes;
+    }
+
+    void release() {
+        block.reset();
+        capacity = vertexBytes = indexOffset = indexBytes = 0;
+    }
+};
+
+#endif //RECONSTRUCTION_MESHARENA_H
@@ -0,0 +1,126 @@
+#ifndef RECONSTRUCTION_MULTIDRAW_H
+#define RECONSTRUCTION_MULTIDRAW_H
+
+#include <glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A batch of draws over the bound VAO, submitted with one GL call. The culling pass adds a command per visible
+// range; draw() uploads them to an indirect buffer for glMultiDraw*Indirect (GL 4.3 or ARB_multi_draw_indirect),
+// or hands the same counts and offsets to glMultiDraw* on GL 3.3. The CPU cost of a frame no longer grows with
+// the number of chunks drawn. Commands never draw more than one instance, so baseInstance is always 0.
+class MultiDraw {
+public:
+    MultiDraw() = default;
+
+    MultiDraw(const MultiDraw &) = delete;
+
+    MultiDraw &operator=(const MultiDraw &) = delete;
+
+    ~MultiDraw() {
+        if (indirectBuffer != 0)
+            glDeleteBuffers(1, &indirectBuffer);
+    }
+
+    static bool indirect() {
+        return GLAD_GL_VERSION_4_3 || GLAD_GL_ARB_multi_draw_indirect;
+    }
+
+    void clear() {
+        elements.clear();
+        arrays.clear();
+    }
+
+    size_t size() const {
+        return elements.size() + arrays.size();
+    }
+
+    // `count` indices from index `firstIndex`, `baseVertex` added to each
+    void addElements(size_t count, size_t firstIndex, GLint baseVertex = 0) {
+        elements.push_back({GLuint(count), 1, GLuint(firstIndex), baseVertex, 0});
+    }
+
+    // `count` vertices from vertex `first`
+    void addArrays(GLint first, GLsizei count) {
+        arrays.push_back({GLuint(count), 1, GLuint(first), 0});
+    }
+
+    // Draws the addElements() commands; `type` is the index type of the bound element buffer
+    void drawElements(GLenum mode, GLenum type) {
+        if (elements.empty())
+            return;
+        if (indirect()) {
+            upload(elements.data(), elements.size() * sizeof(ElementsCommand));
+            glMultiDrawElementsIndirect(mode, type, nullptr, GLsizei(elements.size()), 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            return;
+        }
+        const size_t indexSize = type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+        counts.clear();
+        offsets.clear();
+        baseVertices.clear();
+        bool based = false;
+        for (const ElementsCommand &command: elements) {
+            counts.push_back(GLsizei(command.count));
+            offsets.push_back(reinterpret_cast<const void *>(size_t(command.firstIndex) * indexSize));
+            baseVertices.push_back(command.baseVertex);
+            based = based || command.baseVertex != 0;
+        }
+        if (based)
+            glMultiDrawElementsBaseVertex(mode, counts.data(), type, offsets.data(), GLsizei(counts.size()),
+                                          baseVertices.data());
+        else
+            glMultiDrawElements(mode, counts.data(), type, offsets.data(), GLsizei(counts.size()));
+    }
+
+    // Draws the addArrays() commands
+    void drawArrays(GLenum mode) {
+        if (arrays.empty())
+            return;
+        if (indirect()) {
+            upload(arrays.data(), arrays.size() * sizeof(ArraysCommand));
+            glMultiDrawArraysIndirect(mode, nullptr, GLsizei(arrays.size()), 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            return;
+        }
+        counts.clear();
+        firsts.clear();
+        for (const ArraysCommand &command: arrays) {
+            counts.push_back(GLsizei(command.count));
+            firsts.push_back(GLint(command.first));
+        }
+        glMultiDrawArrays(mode, firsts.data(), counts.data(), GLsizei(counts.size()));
+    }
+
+private:
+    // The layouts glMultiDrawElementsIndirect and glMultiDrawArraysIndirect read
+    struct ElementsCommand {
+        GLuint count, instanceCount, firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    struct ArraysCommand {
+        GLuint count, instanceCount, first, baseInstance;
+    };
+
+    std::vector<ElementsCommand> elements;
+    std::vector<ArraysCommand> arrays;
+    GLuint indirectBuffer = 0;
+    std::vector<GLsizei> counts;
+    std::vector<GLint> firsts, baseVertices;
+    std::vector<const void *> offsets;
+
+    // Leaves the indirect buffer bound; the old storage is orphaned so draws still reading it never stall this
+    void upload(const void *commands, size_t bytes) {
+        if (indirectBuffer == 0)
+            glGenBuffers(1, &indirectBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, GLsizeiptr(bytes), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, GLsizeiptr(bytes), commands);
+    }
+};
+
+#endif //RECONSTRUCTION_MULTIDRAW_H
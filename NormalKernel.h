@@ -0,0 +1,107 @@
+#ifndef RECONSTRUCTION_NORMALKERNEL_H
+#define RECONSTRUCTION_NORMALKERNEL_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RECONSTRUCTION_NORMALS_SSE
+#endif
+
+// Smooth per-vertex normals of a heightfield from central differences of the height grid.
+// A vertex at grid (i, j) sits at (i * spacing, h(i, j) * heightScale + offset, j * spacing), so its
+// normal is normalize(-dh/dx, 1, -dh/dz); borders fall back to one-sided differences. Rows are
+// processed 8 (AVX2) or 4 (SSE) vertices at a time, with a scalar loop for the edges and the tail.
+// x86-64 builds use SSE2 by default and -mavx2 selects AVX2; other targets run the scalar loop.
+struct NormalRow {
+    const float *above;     // row i - 1 (or row i on the first row)
+    const float *row;       // row i
+    const float *below;     // row i + 1 (or row i on the last row)
+    int cols;
+    float scaleX;           // heightScale / distance between `above` and `below`
+    float scaleZ;           // heightScale / (2 * spacing)
+};
+
+inline NormalRow makeNormalRow(const float *above, const float *row, const float *below, int rowsApart, int cols,
+                               float heightScale, float spacing) {
+    return {above, row, below, cols, heightScale / (float(std::max(rowsApart, 1)) * spacing),
+            heightScale / (2.0f * spacing)};
+}
+
+inline glm::vec3 heightfieldNormal(const NormalRow &r, int j) {
+    int left = std::max(j - 1, 0), right = std::min(j + 1, r.cols - 1);
+    float scaleZ = r.scaleZ * (right - left == 1 ? 2.0f : 1.0f);
+    float nx = -(r.below[j] - r.above[j]) * r.scaleX;
+    float nz = -(r.row[right] - r.row[left]) * scaleZ;
+    float inverseLength = 1.0f / std::sqrt(nx * nx + 1.0f + nz * nz);
+    return {nx * inverseLength, inverseLength, nz * inverseLength};
+}
+
+// Writes the normal of every vertex in the row to `out`
+inline void heightfieldNormalsRow(const NormalRow &r, glm::vec3 *out) {
+    int j = 0;
+    if (r.cols > 0)
+        out[j++] = heightfieldNormal(r, 0);
+
+#if defined(__AVX2__)
+    const __m256 scaleX = _mm256_set1_ps(-r.scaleX), scaleZ = _mm256_set1_ps(-r.scaleZ);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    alignas(32) float nx[8], ny[8], nz[8];
+    for (; j + 8 < r.cols; j += 8) {
+        __m256 x = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(r.below + j), _mm256_loadu_ps(r.above + j)), scaleX);
+        __m256 z = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(r.row + j + 1), _mm256_loadu_ps(r.row + j - 1)),
+                                 scaleZ);
+        __m256 lengthSquared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(z, z)), one);
+        __m256 inverseLength = _mm256_div_ps(one, _mm256_sqrt_ps(lengthSquared));
+        _mm256_store_ps(nx, _mm256_mul_ps(x, inverseLength));
+        _mm256_store_ps(ny, inverseLength);
+        _mm256_store_ps(nz, _mm256_mul_ps(z, inverseLength));
+        for (int k = 0; k < 8; k++)
+            out[j + k] = glm::vec3(nx[k], ny[k], nz[k]);
+    }
+#elif defined(RECONSTRUCTION_NORMALS_SSE)
+    const __m128 scaleX = _mm_set1_ps(-r.scaleX), scaleZ = _mm_set1_ps(-r.scaleZ);
+    const __m128 one = _mm_set1_ps(1.0f);
+    alignas(16) float nx[4], ny[4], nz[4];
+    for (; j + 4 < r.cols; j += 4) {
+        __m128 x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(r.below + j), _mm_loadu_ps(r.above + j)), scaleX);
+        __m128 z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(r.row + j + 1), _mm_loadu_ps(r.row + j - 1)), scaleZ);
+        __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(z, z)), one);
+        __m128 inverseLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSquared));
+        _mm_store_ps(nx, _mm_mul_ps(x, inverseLength));
+        _mm_store_ps(ny, inverseLength);
+        _mm_store_ps(nz, _mm_mul_ps(z, inverseLength));
+        for (int k = 0; k < 4; k++)
+            out[j + k] = glm::vec3(nx[k], ny[k], nz[k]);
+    }
+#endif
+    for (; j < r.cols; j++)
+        out[j] = heightfieldNormal(r, j);
+}
+
+// Octahedral encoding of a unit vector into two snorm16 values, folded around +y so the upward normals of a
+// heightfield get the finest steps; the terrain shaders' decodeNormal() inverts it
+inline glm::i16vec2 packOctahedral16(const glm::vec3 &n) {
+    float invL1 = 1.0f / (std::abs(n.x) + std::abs(n.y) + std::abs(n.z));
+    float u = n.x * invL1, v = n.z * invL1;
+    if (n.y < 0.0f) {
+        // fold the lower hemisphere over the diagonals
+        float foldedU = (1.0f - std::abs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+        float foldedV = (1.0f - std::abs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+        u = foldedU;
+        v = foldedV;
+    }
+    auto snorm16 = [](float value) {
+        return int16_t(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+    };
+    return {snorm16(u), snorm16(v)};
+}
+
+#endif //RECONSTRUCTION_NORMALKERNEL_H
@@ -0,0 +1,99 @@
+#ifndef RECONSTRUCTION_OFFSCREENTARGET_H
+#define RECONSTRUCTION_OFFSCREENTARGET_H
+
+#include <glad.h>
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// Framebuffer object with an RGBA8 color and a 24-bit depth renderbuffer, read back through two pixel pack
+// buffers: readPixels() only queues the copy, so the next image can be drawn while the previous one is
+// still in flight, and mapPixels() waits for it.
+class OffscreenTarget {
+public:
+    int width = 0, height = 0;
+    GLuint framebuffer = 0, colorBuffer = 0, depthBuffer = 0;
+    GLuint packBuffers[2] = {0, 0};
+
+    OffscreenTarget() = default;
+
+    OffscreenTarget(const OffscreenTarget &) = delete;
+
+    OffscreenTarget &operator=(const OffscreenTarget &) = delete;
+
+    ~OffscreenTarget() {
+        if (framebuffer != 0) {
+            glDeleteFramebuffers(1, &framebuffer);
+            glDeleteRenderbuffers(1, &colorBuffer);
+            glDeleteRenderbuffers(1, &depthBuffer);
+            glDeleteBuffers(2, packBuffers);
+        }
+    }
+
+    bool setup(int w, int h) {
+        width = w;
+        height = h;
+        glGenFramebuffers(1, &framebuffer);
+        glGenRenderbuffers(1, &colorBuffer);
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (!complete) {
+            std::cout << "Offscreen framebuffer is incomplete" << std::endl;
+            return false;
+        }
+
+        glGenBuffers(2, packBuffers);
+        for (GLuint buffer: packBuffers) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+            glBufferData(GL_PIXEL_PACK_BUFFER, imageSize(), nullptr, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        return true;
+    }
+
+    // Makes the target the draw framebuffer and covers it with the viewport
+    void bind() const {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, width, height);
+    }
+
+    // Queues a copy of the color buffer into pack buffer `slot` (0 or 1)
+    void readPixels(int slot) const {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, packBuffers[slot]);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    // Waits for the copy queued into `slot` and stores it in `pixels`, bottom row first
+    bool mapPixels(int slot, std::vector<unsigned char> &pixels) const {
+        pixels.resize(size_t(imageSize()));
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, packBuffers[slot]);
+        const void *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, imageSize(), GL_MAP_READ_BIT);
+        if (mapped != nullptr) {
+            std::memcpy(pixels.data(), mapped, pixels.size());
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        return mapped != nullptr;
+    }
+
+private:
+    GLsizeiptr imageSize() const {
+        return GLsizeiptr(width) * height * 4;
+    }
+};
+
+#endif //RECONSTRUCTION_OFFSCREENTARGET_H
@@ -0,0 +1,244 @@
+#ifndef RECONSTRUCTION_PNGWRITER_H
+#define RECONSTRUCTION_PNGWRITER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Minimal PNG encoder for 8-bit RGBA images (the headless renderer's output). Every row gets the PNG filter
+// with the smallest sum of absolute residuals, and the filtered rows are compressed as a single
+// fixed-Huffman deflate block with a hash-chain LZ77 matcher.
+class PngWriter {
+public:
+    // Writes a width x height RGBA image stored row by row from the top, or from the bottom with
+    // `bottomUp` (glReadPixels order). Returns false when the file cannot be written.
+    static bool write(const std::string &path, int width, int height, const unsigned char *rgba, bool bottomUp) {
+        const size_t stride = size_t(width) * 4;
+        std::vector<unsigned char> filtered;
+        filtered.reserve((stride + 1) * size_t(height));
+        std::vector<unsigned char> zero(stride, 0), candidate(stride), best(stride);
+        for (int y = 0; y < height; y++) {
+            const unsigned char *row = rgba + size_t(bottomUp ? height - 1 - y : y) * stride;
+            const unsigned char *prior = y == 0 ? zero.data()
+                                                : rgba + size_t(bottomUp ? height - y : y - 1) * stride;
+            unsigned bestFilter = 0;
+            uint64_t bestCost = UINT64_MAX;
+            for (unsigned filter = 0; filter < 5; filter++) {
+                uint64_t cost = 0;
+                for (size_t x = 0; x < stride; x++) {
+                    int a = x >= 4 ? row[x - 4] : 0, b = prior[x], c = x >= 4 ? prior[x - 4] : 0;
+                    candidate[x] = (unsigned char) (row[x] - predict(filter, a, b, c));
+                    cost += std::abs(int((signed char) candidate[x]));
+                }
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestFilter = filter;
+                    best.swap(candidate);
+                }
+            }
+            filtered.push_back((unsigned char) bestFilter);
+            filtered.insert(filtered.end(), best.begin(), best.end());
+        }
+
+        std::vector<unsigned char> header;
+        put32(header, uint32_t(width));
+        put32(header, uint32_t(height));
+        header.insert(header.end(), {8, 6, 0, 0, 0}); // 8 bits per channel, RGBA, deflate, no interlace
+
+        std::ofstream out(path, std::ios::binary);
+        static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        out.write((const char *) signature, sizeof(signature));
+        writeChunk(out, "IHDR", header);
+        writeChunk(out, "IDAT", zlibCompress(filtered));
+        writeChunk(out, "IEND", {});
+        return bool(out);
+    }
+
+private:
+    static int predict(unsigned filter, int a, int b, int c) {
+        switch (filter) {
+            case 1:
+                return a;
+            case 2:
+                return b;
+            case 3:
+                return (a + b) / 2;
+            case 4: {
+                int p = a + b - c, pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+            }
+            default:
+                return 0;
+        }
+    }
+
+    static void put32(std::vector<unsigned char> &out, uint32_t value) {
+        for (int shift = 24; shift >= 0; shift -= 8)
+            out.push_back((unsigned char) (value >> shift));
+    }
+
+    static uint32_t crc32(uint32_t crc, const unsigned char *data, size_t size) {
+        static const std::vector<uint32_t> table = [] {
+            std::vector<uint32_t> t(256);
+            for (uint32_t n = 0; n < 256; n++) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++)
+                    c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                t[n] = c;
+            }
+            return t;
+        }();
+        crc = ~crc;
+        for (size_t k = 0; k < size; k++)
+            crc = table[(crc ^ data[k]) & 0xff] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    static void writeChunk(std::ofstream &out, const char type[4], const std::vector<unsigned char> &data) {
+        std::vector<unsigned char> chunk;
+        put32(chunk, uint32_t(data.size()));
+        chunk.insert(chunk.end(), type, type + 4);
+        chunk.insert(chunk.end(), data.begin(), data.end());
+        put32(chunk, crc32(0, chunk.data() + 4, chunk.size() - 4));
+        out.write((const char *) chunk.data(), std::streamsize(chunk.size()));
+    }
+
+    // Deflate's bit stream: values are packed from the least significant bit, Huffman codes from their first bit
+    struct BitWriter {
+        std::vector<unsigned char> &out;
+        uint32_t buffer = 0;
+        int count = 0;
+
+        void bits(uint32_t value, int length) {
+            buffer |= value << count;
+            count += length;
+            while (count >= 8) {
+                out.push_back((unsigned char) buffer);
+                buffer >>= 8;
+                count -= 8;
+            }
+        }
+
+        void code(uint32_t value, int length) {
+            uint32_t reversed = 0;
+            for (int k = 0; k < length; k++)
+                reversed |= ((value >> k) & 1) << (length - 1 - k);
+            bits(reversed, length);
+        }
+
+        void flush() {
+            if (count > 0)
+                out.push_back((unsigned char) buffer);
+            buffer = 0;
+            count = 0;
+        }
+    };
+
+    // Literal/length symbol with the fixed Huffman code of RFC 1951 3.2.6
+    static void literal(BitWriter &bits, int symbol) {
+        if (symbol < 144)
+            bits.code(0x30 + symbol, 8);
+        else if (symbol < 256)
+            bits.code(0x190 + symbol - 144, 9);
+        else if (symbol < 280)
+            bits.code(symbol - 256, 7);
+        else
+            bits.code(0xc0 + symbol - 280, 8);
+    }
+
+    static void match(BitWriter &bits, int length, int distance) {
+        static const int lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59,
+                                           67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static const int lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4,
+                                            5, 5, 5, 5, 0};
+        static const int distanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+                                             513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385,
+                                             24577};
+        static const int distanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10,
+                                              10, 11, 11, 12, 12, 13, 13};
+        int l = 28;
+        while (lengthBase[l] > length)
+            l--;
+        literal(bits, 257 + l);
+        bits.bits(uint32_t(length - lengthBase[l]), lengthExtra[l]);
+        int d = 29;
+        while (distanceBase[d] > distance)
+            d--;
+        bits.code(uint32_t(d), 5);
+        bits.bits(uint32_t(distance - distanceBase[d]), distanceExtra[d]);
+    }
+
+    static std::vector<unsigned char> zlibCompress(const std::vector<unsigned char> &data) {
+        const int WINDOW = 32768, MIN_MATCH = 3, MAX_MATCH = 258, MAX_CHAIN = 32;
+        const int HASH_BITS = 15;
+        std::vector<unsigned char> out = {0x78, 0x01};
+        BitWriter bits{out};
+        bits.bits(1, 1); // final block
+        bits.bits(1, 2); // fixed Huffman codes
+
+        const size_t size = data.size();
+        std::vector<int> head(size_t(1) << HASH_BITS, -1), previous(WINDOW, -1);
+        auto hash = [&](size_t p) {
+            uint32_t v = uint32_t(data[p]) | uint32_t(data[p + 1]) << 8 | uint32_t(data[p + 2]) << 16;
+            return (v * 2654435761u) >> (32 - HASH_BITS);
+        };
+        auto insert = [&](size_t p) {
+            if (p + MIN_MATCH > size)
+                return;
+            uint32_t h = hash(p);
+            previous[p % WINDOW] = head[h];
+            head[h] = int(p);
+        };
+        size_t p = 0;
+        while (p < size) {
+            int bestLength = 0, bestDistance = 0;
+            if (p + MIN_MATCH <= size) {
+                int limit = int(std::min<size_t>(MAX_MATCH, size - p));
+                int candidate = head[hash(p)];
+                for (int chain = 0; candidate >= 0 && chain < MAX_CHAIN; chain++) {
+                    int distance = int(p) - candidate;
+                    if (distance > WINDOW - 1)
+                        break;
+                    int length = 0;
+                    while (length < limit && data[candidate + length] == data[p + length])
+                        length++;
+                    if (length > bestLength) {
+                        bestLength = length;
+                        bestDistance = distance;
+                        if (length == limit)
+                            break;
+                    }
+                    int next = previous[candidate % WINDOW];
+                    if (next >= candidate)
+                        break;
+                    candidate = next;
+                }
+            }
+            if (bestLength >= MIN_MATCH) {
+                match(bits, bestLength, bestDistance);
+                for (int k = 0; k < bestLength; k++)
+                    insert(p + k);
+                p += bestLength;
+            } else {
+                literal(bits, data[p]);
+                insert(p);
+                p++;
+            }
+        }
+        literal(bits, 256);
+        bits.flush();
+
+        uint32_t a = 1, b = 0;
+        for (unsigned char byte: data) {
+            a = (a + byte) % 65521;
+            b = (b + a) % 65521;
+        }
+        put32(out, b << 16 | a);
+        return out;
+    }
+};
+
+#endif //RECONSTRUCTION_PNGWRITER_H
@@ -0,0 +1,73 @@
+#ifndef RECONSTRUCTION_SCENE_H
+#define RECONSTRUCTION_SCENE_H
+
+#include <glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "shader_m.h"
+#include "camera.h"
+#include "Cube.h"
+#include "Map.h"
+#include "FrameUniforms.h"
+#include "FrameProfiler.h"
+
+// Shaders and per-frame uniforms shared by the window, the headless renderer and benchmarkRender.
+// Shader paths are relative to the build directory, like everything else main.cpp loads; constructing a
+// Scene needs a current context.
+class Scene {
+public:
+    Shader lightingShader{"../shaders/basic_lighting.vs", "../shaders/basic_lighting.fs"};
+    Shader lightCubeShader{"../shaders/light_source.vs", "../shaders/light_source.fs"};
+    Shader displacementShader{"../shaders/terrain_displacement.vs", "../shaders/basic_lighting.fs"};
+    Shader lodShader{"../shaders/terrain_lod.vs", "../shaders/basic_lighting.fs"};
+    FrameUniforms frame;
+
+    Scene() {
+        frame.setup();
+        for (const Shader *sh: {&lightingShader, &lightCubeShader, &displacementShader, &lodShader})
+            FrameUniforms::attach(*sh);
+    }
+
+    // `Terrain` is a Map or a StreamingMap
+    template<typename Terrain>
+    Shader &terrainShader(const Terrain &map) {
+        return map.uses_gpu_displacement() ? displacementShader : map.uses_lod() ? lodShader : lightingShader;
+    }
+
+    // Clears the bound framebuffer and draws the map (scaled by `scale`) and the light cube; each step is
+    // timed when a profiler is given
+    template<typename Terrain>
+    void draw(Terrain &map, Cube &cube, Camera &camera, glm::vec3 lightPos, float scale, int width, int height,
+              FrameProfiler *profiler = nullptr) {
+        {
+            FrameProfiler::Scope scope(profiler, FrameProfiler::CLEAR);
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
+        cube.updatePos(lightPos);
+
+        // view/projection transformations
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float) width / (float) height, 0.1f,
+                                                100.0f);
+        glm::mat4 view = camera.GetViewMatrix();
+        // shared by every shader through the FrameData block
+        frame.update({projection, view, glm::vec4(camera.Position, 1.0f), glm::vec4(lightPos, 1.0f),
+                      glm::vec4(1.0f)});
+
+        // be sure to activate shader when setting uniforms/drawing objects
+        {
+            FrameProfiler::Scope scope(profiler, FrameProfiler::MAP);
+            Shader &terrain = terrainShader(map);
+            terrain.use();
+            map.display(terrain, scale, projection, view, height);
+        }
+
+        FrameProfiler::Scope scope(profiler, FrameProfiler::LIGHT_CUBE);
+        lightCubeShader.use();
+        cube.display(lightCubeShader);
+    }
+};
+
+#endif //RECONSTRUCTION_SCENE_H
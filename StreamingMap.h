@@ -0,0 +1,567 @@
+#ifndef RECONSTRUCTION_STREAMINGMAP_H
+#define RECONSTRUCTION_STREAMINGMAP_H
+
+#include <glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Frustum.h"
+#include "GpuUploader.h"
+#include "NormalKernel.h"
+#include "TerrainMesh.h"
+#include "TiledHeightmap.h"
+#include "Trace.h"
+#include "shader_m.h"
+
+// Out-of-core terrain over a .tiles set (TiledHeightmap.h). Every frame the tiles nearest the eye are
+// wanted; loader threads read and mesh the missing ones, the render thread streams finished tiles to the GPU
+// through a GpuUploader within a per-frame byte budget and draws the resident ones that touch the frustum.
+// Tiles are kept while they fit in the cache budget and evicted least recently wanted first. The render
+// thread only try-locks the loaders' queue, so a frame never waits for the disk.
+//
+// Every tile is a (tileSize + 1)^2 grid of TerrainMesh vertices in its own VBO; all tiles share one index
+// buffer. Draw with the basic lighting shader.
+class StreamingMap {
+public:
+    // What the last display() call submitted, and the state of the cache
+    struct FrameStats {
+        size_t chunks = 0;          // tiles in the set
+        size_t visibleChunks = 0;   // resident tiles drawn
+        size_t drawCalls = 0;
+        size_t triangles = 0;
+        size_t residentTiles = 0;
+        size_t pendingTiles = 0;    // queued, loading or waiting for upload
+        size_t residentBytes = 0;
+        size_t uploadedBytes = 0;   // staged for the GPU this frame
+    };
+
+    explicit StreamingMap(std::string tilesFilename) : tilesPath(std::move(tilesFilename)) {}
+
+    StreamingMap(const StreamingMap &) = delete;
+
+    StreamingMap &operator=(const StreamingMap &) = delete;
+
+    ~StreamingMap() {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueReady.notify_all();
+        for (std::thread &loader: loaders)
+            loader.join();
+        for (const GpuTile &gpu: gpuTiles) {
+            glDeleteVertexArrays(1, &gpu.vao);
+            glDeleteBuffers(1, &gpu.vbo);
+        }
+        if (ebo != 0)
+            glDeleteBuffers(1, &ebo);
+    }
+
+    // Reads the tile directory; rows, cols and the height range are known from here on
+    bool open() {
+        if (!tiles.open(tilesPath))
+            return false;
+        const TileSetHeader &header = tiles.header();
+        tileSize = int(header.tileSize);
+        min_height = header.minHeight;
+        max_height = header.maxHeight;
+        slots.assign(size_t(tiles.tileCount()), TileSlot());
+        return true;
+    }
+
+    int rows() const {
+        return int(tiles.header().rows);
+    }
+
+    int cols() const {
+        return int(tiles.header().cols);
+    }
+
+    // Bytes of tile meshes (resident, loading or waiting for upload) the cache may hold
+    void set_cache_budget(size_t bytes) {
+        cacheBudget = bytes;
+    }
+
+    // Farthest tiles are requested from the eye, in model units; 0 requests as many as the budget holds
+    void set_view_distance(float distance) {
+        viewDistance = std::max(distance, 0.0f);
+    }
+
+    // Bytes of finished tiles uploaded per frame; more streams tiles in sooner, less keeps frame times flat
+    void set_upload_budget(size_t bytes) {
+        uploader.set_frame_budget(bytes);
+    }
+
+    void set_loader_threads(unsigned threads) {
+        loaderThreads = std::max(threads, 1u);
+    }
+
+    // World height of normalized 0 and 1, from the tile set header once open
+    double min_elevation() const {
+        return min_height;
+    }
+
+    double max_elevation() const {
+        return max_height;
+    }
+
+    // The normals bake both in, so a change drops every tile and streams them in again
+    void set_height_range(double minh, double maxh) {
+        if (minh == min_height && maxh == max_height)
+            return;
+        min_height = minh;
+        max_height = maxh;
+        dropAll();
+    }
+
+    void change_proximity(double scale_factor) {
+        if (scale_factor == this->scale_factor)
+            return;
+        this->scale_factor = scale_factor;
+        dropAll();
+    }
+
+    bool uses_gpu_displacement() const {
+        return false;
+    }
+
+    bool uses_lod() const {
+        return false;
+    }
+
+    // Builds the shared index buffer and starts the loaders; needs a current context
+    void setup() {
+        TRACE_ZONE("StreamingMap::setup");
+        if (!tiles.isOpen() && !open())
+            return;
+        std::vector<GLuint> indices;
+        indices.reserve(size_t(tileSize) * tileSize * 6);
+        const GLuint side = GLuint(tileSize + 1);
+        for (GLuint i = 0; i < GLuint(tileSize); i++) {
+            for (GLuint j = 0; j < GLuint(tileSize); j++) {
+                indices.insert(indices.end(), {i * side + j + 1, i * side + j, (i + 1) * side + j,
+                                               (i + 1) * side + j + 1, i * side + j + 1, (i + 1) * side + j});
+            }
+        }
+        indexCount = GLsizei(indices.size());
+        glGenBuffers(1, &ebo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(indices.size() * sizeof(GLuint)), indices.data(),
+                     GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        uploader.setup();
+
+        for (unsigned k = 0; k < loaderThreads; k++)
+            loaders.emplace_back([this] { loaderLoop(); });
+    }
+
+    // Streams towards the eye, then draws the resident tiles whose boxes touch the view frustum
+    void display(Shader &sh, float cambio_escala, const glm::mat4 &projection, const glm::mat4 &view,
+                 int viewportHeight) {
+        (void) viewportHeight;
+        stats = FrameStats();
+        if (ebo == 0)
+            return;
+        // the model matrix only scales, so the model-space eye is the world-space one divided by the scale
+        glm::vec3 eye = glm::vec3(glm::inverse(view)[3]) / cambio_escala;
+        update(eye);
+
+        glm::mat4 model = glm::scale(glm::mat4(1.0), glm::vec3(cambio_escala));
+        sh.setMat4("model", model);
+        TerrainMesh::setGrid(sh, 0, 0, tileSize + 1, rows() - 1, cols() - 1, float(scale_factor), float(min_height),
+                             float(max_height));
+        const GLint originLocation = sh.uniformLocation("gridOrigin");
+        Frustum frustum(projection * view * model);
+        for (int tile: residentTiles) {
+            glm::vec3 boundsMin, boundsMax;
+            tileBounds(tile, boundsMin, boundsMax);
+            if (frustum.classify(boundsMin, boundsMax) == Frustum::OUTSIDE)
+                continue;
+            sh.setIVec2(originLocation, tileRow(tile) * tileSize, tileCol(tile) * tileSize);
+            glBindVertexArray(gpuTiles[size_t(slots[tile].gpu)].vao);
+            glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr);
+            stats.visibleChunks++;
+        }
+        glBindVertexArray(0);
+        stats.chunks = slots.size();
+        stats.drawCalls = stats.visibleChunks;
+        stats.triangles = stats.visibleChunks * size_t(tileSize) * tileSize * 2;
+        stats.residentTiles = residentTiles.size();
+        stats.pendingTiles = ready.size() + queuedTiles.size() + inFlight + uploading;
+        stats.residentBytes = residentTiles.size() * tileBytes();
+        stats.uploadedBytes = uploader.frame_stats().bytes;
+    }
+
+    const FrameStats &frame_stats() const {
+        return stats;
+    }
+
+private:
+    enum TileState : uint8_t {
+        TILE_ABSENT, TILE_QUEUED, TILE_LOADING, TILE_READY, TILE_UPLOADING, TILE_RESIDENT
+    };
+
+    struct TileSlot {
+        TileState state = TILE_ABSENT;
+        int gpu = -1;               // index into gpuTiles while uploading or resident
+        int resident = -1;          // index into residentTiles while resident
+        uint64_t lastWanted = 0;    // frame the tile was last among the wanted ones
+    };
+
+    struct Request {
+        int tile;
+        unsigned generation;
+        float minHeight, maxHeight, spacing;
+    };
+
+    struct LoadedTile {
+        int tile;
+        unsigned generation;
+        std::vector<TerrainMesh::Vertex> vertices;
+    };
+
+    struct GpuTile {
+        GLuint vao = 0, vbo = 0;
+    };
+
+    std::string tilesPath;
+    TileSetFile tiles;
+    int tileSize = DEFAULT_TILE_SIZE;
+    double min_height = DEFAULT_MIN_HEIGHT, max_height = DEFAULT_MAX_HEIGHT, scale_factor = 1.0;
+    size_t cacheBudget = size_t(512) << 20;
+    float viewDistance = 0.0f;
+    unsigned loaderThreads = 2;
+
+    // render thread state
+    std::vector<TileSlot> slots;
+    std::vector<int> residentTiles;
+    std::deque<LoadedTile> ready;   // meshed, waiting for upload
+    size_t uploading = 0;           // tiles handed to the uploader
+    GpuUploader uploader;
+    std::vector<int> queuedTiles;   // what the queue held when it was last filled
+    size_t inFlight = 0;            // tiles a loader has taken
+    std::vector<GpuTile> gpuTiles;
+    std::vector<int> freeGpuTiles;
+    GLuint ebo = 0;
+    GLsizei indexCount = 0;
+    unsigned generation = 0;        // bumped whenever built tiles go stale
+    uint64_t frame = 0;
+    FrameStats stats;
+
+    // shared with the loaders, under queueMutex
+    std::mutex queueMutex;
+    std::condition_variable queueReady;
+    std::deque<Request> queue;
+    std::vector<LoadedTile> finished;
+    bool stopping = false;
+    std::vector<std::thread> loaders;
+
+    size_t tileBytes() const {
+        return size_t(tileSize + 1) * size_t(tileSize + 1) * sizeof(TerrainMesh::Vertex);
+    }
+
+    size_t maxTiles() const {
+        return std::max<size_t>(cacheBudget / tileBytes(), 1);
+    }
+
+    int tileRow(int tile) const {
+        return tile / int(tiles.header().tileCols);
+    }
+
+    int tileCol(int tile) const {
+        return tile % int(tiles.header().tileCols);
+    }
+
+    glm::vec3 gridPosition(int i, int j, float normalizedHeight) const {
+        return glm::vec3(float(i * scale_factor), float(normalizedHeight * (max_height - min_height) + min_height),
+                         float(j * scale_factor));
+    }
+
+    void tileBounds(int tile, glm::vec3 &boundsMin, glm::vec3 &boundsMax) const {
+        const TileEntry &entry = tiles.entry(tile);
+        const int row = tileRow(tile) * tileSize, col = tileCol(tile) * tileSize;
+        glm::vec3 a = gridPosition(row, col, entry.heightMin);
+        glm::vec3 b = gridPosition(std::min(row + tileSize, rows() - 1), std::min(col + tileSize, cols() - 1),
+                                   entry.heightMax);
+        boundsMin = glm::min(a, b);
+        boundsMax = glm::max(a, b);
+    }
+
+    // Horizontal distance from the eye to a tile's box
+    float tileDistance(int tile, const glm::vec3 &eye) const {
+        glm::vec3 boundsMin, boundsMax;
+        tileBounds(tile, boundsMin, boundsMax);
+        float dx = std::max({boundsMin.x - eye.x, 0.0f, eye.x - boundsMax.x});
+        float dz = std::max({boundsMin.z - eye.z, 0.0f, eye.z - boundsMax.z});
+        return std::sqrt(dx * dx + dz * dz);
+    }
+
+    void update(const glm::vec3 &eye) {
+        TRACE_ZONE("StreamingMap::update");
+        frame++;
+        uploadReady();
+
+        std::unique_lock<std::mutex> lock(queueMutex, std::try_to_lock);
+        if (!lock.owns_lock())
+            return; // a loader is handing over a tile; try again next frame
+        std::vector<LoadedTile> arrived;
+        arrived.swap(finished);
+        // whatever is still queued was not started; the rest of the last batch went to the loaders
+        for (const Request &request: queue)
+            slots[request.tile].state = TILE_ABSENT;
+        queue.clear();
+        for (int tile: queuedTiles) {
+            if (slots[tile].state == TILE_QUEUED) {
+                slots[tile].state = TILE_LOADING;
+                inFlight++;
+            }
+        }
+        queuedTiles.clear();
+        lock.unlock();
+
+        for (LoadedTile &tile: arrived) {
+            TileSlot &slot = slots[tile.tile];
+            inFlight--;
+            if (tile.generation != generation) {
+                slot.state = TILE_ABSENT;
+                continue;
+            }
+            slot.state = TILE_READY;
+            ready.push_back(std::move(tile));
+        }
+
+        std::vector<int> missing = wantedTiles(eye);
+        // make room for the missing tiles by evicting the least recently wanted ones
+        const size_t limit = maxTiles();
+        size_t held = residentTiles.size() + ready.size() + inFlight + uploading;
+        while (held + missing.size() > limit && evictLeastRecentlyWanted())
+            held--;
+        missing.resize(std::min(missing.size(), limit > held ? limit - held : 0));
+        if (missing.empty())
+            return;
+
+        for (int tile: missing)
+            slots[tile].state = TILE_QUEUED;
+        queuedTiles = missing;
+        lock.lock();
+        for (int tile: missing)
+            queue.push_back({tile, generation, float(min_height), float(max_height), float(scale_factor)});
+        lock.unlock();
+        queueReady.notify_all();
+    }
+
+    // Marks the tiles nearest the eye (as many as the budget holds) as wanted and returns the absent ones,
+    // nearest first
+    std::vector<int> wantedTiles(const glm::vec3 &eye) {
+        const size_t limit = maxTiles();
+        const float tileExtent = float(tileSize * scale_factor);
+        // a square of tiles around the eye that holds the budget, cut down to the view distance
+        int radius = int(std::ceil(std::sqrt(double(limit)) * 0.5)) + 1;
+        if (viewDistance > 0.0f)
+            radius = std::min(radius, int(std::ceil(viewDistance / tileExtent)) + 1);
+        const int centerRow = int(std::floor(eye.x / tileExtent)), centerCol = int(std::floor(eye.z / tileExtent));
+        const int tileRows = int(tiles.header().tileRows), tileCols = int(tiles.header().tileCols);
+
+        std::vector<std::pair<float, int>> candidates;
+        for (int r = std::max(centerRow - radius, 0); r <= std::min(centerRow + radius, tileRows - 1); r++) {
+            for (int c = std::max(centerCol - radius, 0); c <= std::min(centerCol + radius, tileCols - 1); c++) {
+                int tile = r * tileCols + c;
+                float distance = tileDistance(tile, eye);
+                if (viewDistance <= 0.0f || distance <= viewDistance)
+                    candidates.emplace_back(distance, tile);
+            }
+        }
+        if (candidates.size() > limit) {
+            std::nth_element(candidates.begin(), candidates.begin() + std::ptrdiff_t(limit), candidates.end());
+            candidates.resize(limit);
+        }
+        std::sort(candidates.begin(), candidates.end());
+
+        std::vector<int> missing;
+        for (const auto &candidate: candidates) {
+            TileSlot &slot = slots[candidate.second];
+            slot.lastWanted = frame;
+            if (slot.state == TILE_ABSENT)
+                missing.push_back(candidate.second);
+        }
+        return missing;
+    }
+
+    // Drops the resident or ready tile wanted longest ago, unless every one of them is wanted this frame
+    bool evictLeastRecentlyWanted() {
+        int victim = -1;
+        uint64_t oldest = frame;
+        for (int tile: residentTiles) {
+            if (slots[tile].lastWanted < oldest) {
+                oldest = slots[tile].lastWanted;
+                victim = tile;
+            }
+        }
+        for (const LoadedTile &tile: ready) {
+            if (slots[tile.tile].lastWanted < oldest) {
+                oldest = slots[tile.tile].lastWanted;
+                victim = tile.tile;
+            }
+        }
+        if (victim < 0)
+            return false;
+        evict(victim);
+        return true;
+    }
+
+    void evict(int tile) {
+        TileSlot &slot = slots[tile];
+        if (slot.state == TILE_RESIDENT) {
+            freeGpuTiles.push_back(slot.gpu);
+            int last = residentTiles.back();
+            residentTiles[size_t(slot.resident)] = last;
+            slots[last].resident = slot.resident;
+            residentTiles.pop_back();
+        } else if (slot.state == TILE_READY) {
+            ready.erase(std::find_if(ready.begin(), ready.end(), [tile](const LoadedTile &t) {
+                return t.tile == tile;
+            }));
+        }
+        slot.state = TILE_ABSENT;
+        slot.gpu = slot.resident = -1;
+    }
+
+    // Everything built so far is stale: resident and ready tiles go, queued ones are withdrawn and the ones
+    // being loaded or uploaded are discarded when they arrive
+    void dropAll() {
+        generation++;
+        while (!residentTiles.empty())
+            evict(residentTiles.back());
+        while (!ready.empty())
+            evict(ready.back().tile);
+        std::lock_guard<std::mutex> lock(queueMutex);
+        for (const Request &request: queue)
+            slots[request.tile].state = TILE_ABSENT;
+        queue.clear();
+    }
+
+    // Hands ready tiles to the uploader while its queue is under a frame's budget, so a tile evicted before its
+    // turn never costs an upload, then lets it stage this frame's share. A tile whose last byte went out becomes
+    // resident; one made stale meanwhile gives its VBO back
+    void uploadReady() {
+        TRACE_ZONE("StreamingMap::upload");
+        while (!ready.empty() && uploader.pending_bytes() < uploader.frame_budget()) {
+            LoadedTile tile = std::move(ready.front());
+            ready.pop_front();
+            TileSlot &slot = slots[tile.tile];
+            slot.state = TILE_UPLOADING;
+            slot.gpu = acquireGpuTile();
+            uploading++;
+            uploader.upload(gpuTiles[size_t(slot.gpu)].vbo, 0, std::move(tile.vertices),
+                            [this, index = tile.tile, built = tile.generation] {
+                                uploaded(index, built);
+                            });
+        }
+        uploader.process();
+    }
+
+    void uploaded(int tile, unsigned built) {
+        TileSlot &slot = slots[tile];
+        uploading--;
+        if (built != generation) {
+            freeGpuTiles.push_back(slot.gpu);
+            slot.state = TILE_ABSENT;
+            slot.gpu = -1;
+            return;
+        }
+        slot.state = TILE_RESIDENT;
+        slot.resident = int(residentTiles.size());
+        residentTiles.push_back(tile);
+    }
+
+    // A VAO and a VBO sized for a tile, recycled from an evicted tile when there is one
+    int acquireGpuTile() {
+        if (!freeGpuTiles.empty()) {
+            int index = freeGpuTiles.back();
+            freeGpuTiles.pop_back();
+            return index;
+        }
+        GpuTile gpu;
+        glGenVertexArrays(1, &gpu.vao);
+        glGenBuffers(1, &gpu.vbo);
+        glBindVertexArray(gpu.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, gpu.vbo);
+        glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(tileBytes()), nullptr, GL_STATIC_DRAW);
+        TerrainMesh::vertexFormat(0, 1, 2, 3);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        gpuTiles.push_back(gpu);
+        return int(gpuTiles.size()) - 1;
+    }
+
+    void loaderLoop() {
+        Trace::nameThread("tile loader");
+        const int side = tileSide(tileSize);
+        Grid2D<float> heights(side, side);
+        Grid2D<glm::u8vec3> colors(side, side);
+        std::vector<glm::vec3> normals(side);
+        for (;;) {
+            Request request;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueReady.wait(lock, [&] { return stopping || !queue.empty(); });
+                if (stopping)
+                    return;
+                request = queue.front();
+                queue.pop_front();
+            }
+            LoadedTile loaded{request.tile, request.generation, {}};
+            {
+                Trace::Zone zone("StreamingMap::loadTile");
+                tiles.readHeights(request.tile, heights);
+                tiles.readRGB(request.tile, colors);
+                tiles.release(request.tile);
+                buildTile(request, heights, colors, normals, loaded.vertices);
+            }
+            std::lock_guard<std::mutex> lock(queueMutex);
+            finished.push_back(std::move(loaded));
+        }
+    }
+
+    // Vertex (a, b) of a tile is apron sample (a + 1, b + 1); the shader collapses vertices past the map edge
+    // onto it. The apron repeats the edge there, so the normals skip it and take one-sided differences as Map's do.
+    void buildTile(const Request &request, const Grid2D<float> &heights, const Grid2D<glm::u8vec3> &colors,
+                   std::vector<glm::vec3> &normals, std::vector<TerrainMesh::Vertex> &vertices) const {
+        const int side = tileSide(tileSize);
+        const float heightScale = request.maxHeight - request.minHeight;
+        const int row0 = tileRow(request.tile) * tileSize, col0 = tileCol(request.tile) * tileSize;
+        // apron columns of the first and last map columns the tile reaches
+        const int firstCol = col0 == 0 ? 1 : 0, lastCol = std::min(cols() - col0, side - 1);
+        vertices.resize(size_t(tileSize + 1) * size_t(tileSize + 1));
+        TerrainMesh::Vertex *out = vertices.data();
+        for (int a = 0; a <= tileSize; a++) {
+            const int above = row0 + a > 0 ? a : a + 1, below = row0 + a < rows() - 1 ? a + 2 : a + 1;
+            NormalRow normalRow = makeNormalRow(heights.row(above) + firstCol, heights.row(a + 1) + firstCol,
+                                                heights.row(below) + firstCol, below - above,
+                                                lastCol - firstCol + 1, heightScale, request.spacing);
+            heightfieldNormalsRow(normalRow, normals.data() + firstCol);
+            const float *h = heights.row(a + 1);
+            const glm::u8vec3 *c = colors.row(a + 1);
+            for (int b = 0; b <= tileSize; b++, out++) {
+                const uint16_t height = TerrainMesh::packHeight(h[b + 1]);
+                out->height = glm::u16vec2(height, height);
+                out->normal = packOctahedral16(normals[size_t(std::min(b + 1, lastCol))]);
+                out->color = glm::u8vec4(c[b + 1], 0);
+            }
+        }
+    }
+};
+
+#endif //RECONSTRUCTION_STREAMINGMAP_H
@@ -0,0 +1,281 @@
+#ifndef RECONSTRUCTION_TERRAINGENERATOR_H
+#define RECONSTRUCTION_TERRAINGENERATOR_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "Grid2D.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Procedural terrain the way processTerrain.py makes the perlin dataset, at any size: fractal (fBm) OpenSimplex2
+// noise sampled at (row / scale, col / scale), normalized to [0, 1] and colored by elevation biome.
+// Lines of samples are evaluated 8 at a time with AVX2 (build with -mavx2; other targets run the scalar loop)
+// and the grid is split into tiles spread over the shared thread pool.
+
+// OpenSimplex2 2D noise (the "fast" variant by K.jpg) with a 32-bit lattice hash, so the vector path can hash
+// eight points with 32-bit multiplies; values lie in about [-1, 1]
+class OpenSimplex2 {
+public:
+    explicit OpenSimplex2(uint32_t seed) : seed(seed), table(gradients()) {}
+
+    float noise(float x, float y) const {
+        float s = SKEW * (x + y);
+        float xs = x + s, ys = y + s;
+        float xsb = std::floor(xs), ysb = std::floor(ys);
+        float xi = xs - xsb, yi = ys - ysb;
+        uint32_t xp = uint32_t(int32_t(xsb)) * PRIME_X, yp = uint32_t(int32_t(ysb)) * PRIME_Y;
+
+        // the three corners of the simplex (xi, yi) falls in
+        float t = (xi + yi) * UNSKEW;
+        float dx0 = xi + t, dy0 = yi + t;
+        float a0 = RADIUS_SQUARED - dx0 * dx0 - dy0 * dy0;
+        float value = contribution(a0, xp, yp, dx0, dy0);
+        float a1 = A1_SLOPE * t + (A1_OFFSET + a0);
+        value += contribution(a1, xp + PRIME_X, yp + PRIME_Y, dx0 - CORNER, dy0 - CORNER);
+        float dx2, dy2;
+        if (dy0 > dx0) {
+            dx2 = dx0 - UNSKEW;
+            dy2 = dy0 - (UNSKEW + 1.0f);
+            yp += PRIME_Y;
+        } else {
+            dx2 = dx0 - (UNSKEW + 1.0f);
+            dy2 = dy0 - UNSKEW;
+            xp += PRIME_X;
+        }
+        return value + contribution(RADIUS_SQUARED - dx2 * dx2 - dy2 * dy2, xp, yp, dx2, dy2);
+    }
+
+    // acc[k] += amplitude * noise(x, y0 + k * dy) for k < count
+    void accumulateLine(float x, float y0, float dy, int count, float amplitude, float *acc) const {
+        int k = 0;
+#if defined(__AVX2__)
+        k = accumulateLineAVX2(x, y0, dy, count, amplitude, acc);
+#endif
+        accumulateLineScalar(x, y0, dy, k, count, amplitude, acc);
+    }
+
+    // Scalar loop over [first, count), also what benchmarkTerrain compares the vector path against
+    void accumulateLineScalar(float x, float y0, float dy, int first, int count, float amplitude, float *acc) const {
+        for (int k = first; k < count; k++)
+            acc[k] += amplitude * noise(x, y0 + float(k) * dy);
+    }
+
+private:
+    static constexpr float SKEW = 0.366025403784439f;
+    static constexpr double UNSKEW_D = -0.21132486540518713;
+    static constexpr float UNSKEW = float(UNSKEW_D);
+    static constexpr float CORNER = float(1 + 2 * UNSKEW_D);
+    static constexpr float A1_SLOPE = float(2 * (1 + 2 * UNSKEW_D) * (1 / UNSKEW_D + 2));
+    static constexpr float A1_OFFSET = float(-2 * (1 + 2 * UNSKEW_D) * (1 + 2 * UNSKEW_D));
+    static constexpr float RADIUS_SQUARED = 0.5f;
+    static const uint32_t PRIME_X = 0x5205402Bu, PRIME_Y = 0x598CD327u, HASH_MULTIPLIER = 0x53A3F72Du;
+    static const int GRADIENT_BITS = 7;
+
+    uint32_t seed;
+    const float *table;
+
+    // 128 gradients (24 directions repeated), x and y interleaved and pre-divided by the noise normalizer
+    static const float *gradients() {
+        static const std::vector<float> table = [] {
+            static const double directions[48] = {
+                    0.38268343236509, 0.923879532511287, 0.923879532511287, 0.38268343236509,
+                    0.923879532511287, -0.38268343236509, 0.38268343236509, -0.923879532511287,
+                    -0.38268343236509, -0.923879532511287, -0.923879532511287, -0.38268343236509,
+                    -0.923879532511287, 0.38268343236509, -0.38268343236509, 0.923879532511287,
+                    0.130526192220052, 0.99144486137381, 0.608761429008721, 0.793353340291235,
+                    0.793353340291235, 0.608761429008721, 0.99144486137381, 0.130526192220051,
+                    0.99144486137381, -0.130526192220051, 0.793353340291235, -0.60876142900872,
+                    0.608761429008721, -0.793353340291235, 0.130526192220052, -0.99144486137381,
+                    -0.130526192220052, -0.99144486137381, -0.608761429008721, -0.793353340291235,
+                    -0.793353340291235, -0.608761429008721, -0.99144486137381, -0.130526192220052,
+                    -0.99144486137381, 0.130526192220051, -0.793353340291235, 0.608761429008721,
+                    -0.608761429008721, 0.793353340291235, -0.130526192220052, 0.99144486137381};
+            std::vector<float> values(size_t(2) << GRADIENT_BITS);
+            for (size_t k = 0; k < values.size(); k++)
+                values[k] = float(directions[k % 48] / 0.01001634121365712);
+            return values;
+        }();
+        return table.data();
+    }
+
+    // Index of the x component of the gradient at a hashed lattice point
+    uint32_t gradientIndex(uint32_t xp, uint32_t yp) const {
+        uint32_t hash = (seed ^ xp ^ yp) * HASH_MULTIPLIER;
+        hash ^= hash >> (32 - GRADIENT_BITS + 1);
+        return hash & (((1u << GRADIENT_BITS) - 1) << 1);
+    }
+
+    float contribution(float a, uint32_t xp, uint32_t yp, float dx, float dy) const {
+        if (a <= 0.0f)
+            return 0.0f;
+        uint32_t index = gradientIndex(xp, yp);
+        return (a * a) * (a * a) * (table[index] * dx + table[index + 1] * dy);
+    }
+
+#if defined(__AVX2__)
+    __m256 contribution8(__m256 a, __m256i xp, __m256i yp, __m256 dx, __m256 dy) const {
+        __m256i hash = _mm256_mullo_epi32(_mm256_xor_si256(_mm256_set1_epi32(int(seed)), _mm256_xor_si256(xp, yp)),
+                                          _mm256_set1_epi32(int(HASH_MULTIPLIER)));
+        hash = _mm256_xor_si256(hash, _mm256_srli_epi32(hash, 32 - GRADIENT_BITS + 1));
+        __m256i index = _mm256_and_si256(hash, _mm256_set1_epi32(((1 << GRADIENT_BITS) - 1) << 1));
+        __m256 gx = _mm256_i32gather_ps(table, index, 4);
+        __m256 gy = _mm256_i32gather_ps(table + 1, index, 4);
+        a = _mm256_max_ps(a, _mm256_setzero_ps());
+        __m256 a2 = _mm256_mul_ps(a, a);
+        return _mm256_mul_ps(_mm256_mul_ps(a2, a2), _mm256_add_ps(_mm256_mul_ps(gx, dx), _mm256_mul_ps(gy, dy)));
+    }
+
+    // Same steps as noise() on eight points; returns how many samples it handled
+    int accumulateLineAVX2(float x, float y0, float dy, int count, float amplitude, float *acc) const {
+        const __m256 lanes = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256 xv = _mm256_set1_ps(x), y0v = _mm256_set1_ps(y0), dyv = _mm256_set1_ps(dy);
+        const __m256 amplitudeV = _mm256_set1_ps(amplitude), skew = _mm256_set1_ps(SKEW);
+        const __m256 unskew = _mm256_set1_ps(UNSKEW), unskewPlusOne = _mm256_set1_ps(UNSKEW + 1.0f);
+        const __m256 corner = _mm256_set1_ps(CORNER), radius = _mm256_set1_ps(RADIUS_SQUARED);
+        const __m256i primeX = _mm256_set1_epi32(int(PRIME_X)), primeY = _mm256_set1_epi32(int(PRIME_Y));
+        int k = 0;
+        for (; k + 8 <= count; k += 8) {
+            __m256 y = _mm256_add_ps(y0v, _mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps(float(k)), lanes), dyv));
+            __m256 s = _mm256_mul_ps(skew, _mm256_add_ps(xv, y));
+            __m256 xs = _mm256_add_ps(xv, s), ys = _mm256_add_ps(y, s);
+            __m256 xsb = _mm256_floor_ps(xs), ysb = _mm256_floor_ps(ys);
+            __m256 xi = _mm256_sub_ps(xs, xsb), yi = _mm256_sub_ps(ys, ysb);
+            __m256i xp = _mm256_mullo_epi32(_mm256_cvttps_epi32(xsb), primeX);
+            __m256i yp = _mm256_mullo_epi32(_mm256_cvttps_epi32(ysb), primeY);
+
+            __m256 t = _mm256_mul_ps(_mm256_add_ps(xi, yi), unskew);
+            __m256 dx0 = _mm256_add_ps(xi, t), dy0 = _mm256_add_ps(yi, t);
+            __m256 a0 = _mm256_sub_ps(_mm256_sub_ps(radius, _mm256_mul_ps(dx0, dx0)), _mm256_mul_ps(dy0, dy0));
+            __m256 value = contribution8(a0, xp, yp, dx0, dy0);
+            __m256 a1 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(A1_SLOPE), t),
+                                      _mm256_add_ps(_mm256_set1_ps(A1_OFFSET), a0));
+            value = _mm256_add_ps(value, contribution8(a1, _mm256_add_epi32(xp, primeX), _mm256_add_epi32(yp, primeY),
+                                                       _mm256_sub_ps(dx0, corner), _mm256_sub_ps(dy0, corner)));
+            // third corner: (0, 1) where dy0 > dx0, (1, 0) elsewhere
+            __m256 above = _mm256_cmp_ps(dy0, dx0, _CMP_GT_OQ);
+            __m256i aboveBits = _mm256_castps_si256(above);
+            __m256 dx2 = _mm256_sub_ps(dx0, _mm256_blendv_ps(unskewPlusOne, unskew, above));
+            __m256 dy2 = _mm256_sub_ps(dy0, _mm256_blendv_ps(unskew, unskewPlusOne, above));
+            __m256i xp2 = _mm256_add_epi32(xp, _mm256_andnot_si256(aboveBits, primeX));
+            __m256i yp2 = _mm256_add_epi32(yp, _mm256_and_si256(aboveBits, primeY));
+            __m256 a2 = _mm256_sub_ps(_mm256_sub_ps(radius, _mm256_mul_ps(dx2, dx2)), _mm256_mul_ps(dy2, dy2));
+            value = _mm256_add_ps(value, contribution8(a2, xp2, yp2, dx2, dy2));
+
+            _mm256_storeu_ps(acc + k, _mm256_add_ps(_mm256_loadu_ps(acc + k), _mm256_mul_ps(amplitudeV, value)));
+        }
+        return k;
+    }
+#endif
+};
+
+// fBm parameters; the defaults are processTerrain.py's
+struct TerrainNoise {
+    uint32_t seed = 0;
+    float scale = 10.0f;        // grid cells per noise unit at the first octave
+    int octaves = 6;
+    float lacunarity = 2.0f;    // frequency multiplier between octaves
+    float gain = 0.5f;          // amplitude multiplier between octaves
+};
+
+// Side of the square tiles the generator hands to the pool
+const int TERRAIN_TILE = 256;
+
+// Fills `heights` (rows x cols) with fBm noise normalized to [0, 1]; octave k uses seed + k
+inline void generateHeights(const TerrainNoise &settings, int rows, int cols, Grid2D<float> &heights) {
+    TRACE_ZONE("generateHeights");
+    heights = Grid2D<float>(rows, cols, 0.0f);
+    std::vector<OpenSimplex2> octaves;
+    for (int o = 0; o < settings.octaves; o++)
+        octaves.emplace_back(settings.seed + uint32_t(o));
+
+    const int tileRows = (rows + TERRAIN_TILE - 1) / TERRAIN_TILE, tileCols = (cols + TERRAIN_TILE - 1) / TERRAIN_TILE;
+    const size_t tiles = size_t(tileRows) * size_t(tileCols);
+    std::vector<float> tileMin(tiles, std::numeric_limits<float>::max());
+    std::vector<float> tileMax(tiles, std::numeric_limits<float>::lowest());
+    ThreadPool::shared().parallelFor(tiles, 1, [&](size_t first, size_t last) {
+        for (size_t tile = first; tile < last; tile++) {
+            const int i0 = int(tile / size_t(tileCols)) * TERRAIN_TILE, j0 = int(tile % size_t(tileCols)) * TERRAIN_TILE;
+            const int i1 = std::min(i0 + TERRAIN_TILE, rows), count = std::min(TERRAIN_TILE, cols - j0);
+            float low = tileMin[tile], high = tileMax[tile];
+            for (int i = i0; i < i1; i++) {
+                float *h = heights.row(i) + j0;
+                float frequency = 1.0f / settings.scale, amplitude = 1.0f;
+                for (const OpenSimplex2 &octave: octaves) {
+                    octave.accumulateLine(float(i) * frequency, float(j0) * frequency, frequency, count, amplitude, h);
+                    frequency *= settings.lacunarity;
+                    amplitude *= settings.gain;
+                }
+                for (int j = 0; j < count; j++) {
+                    low = std::min(low, h[j]);
+                    high = std::max(high, h[j]);
+                }
+            }
+            tileMin[tile] = low;
+            tileMax[tile] = high;
+        }
+    });
+
+    // (h - min) / (max - min), as processTerrain.py normalizes
+    float low = *std::min_element(tileMin.begin(), tileMin.end());
+    float high = *std::max_element(tileMax.begin(), tileMax.end());
+    const float inverse = high > low ? 1.0f / (high - low) : 0.0f;
+    ThreadPool::shared().parallelFor(size_t(rows), 16, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+            float *h = heights.row(int(i));
+            for (int j = 0; j < cols; j++)
+                h[j] = (h[j] - low) * inverse;
+        }
+    });
+}
+
+// processTerrain.py's classify_terrain: biome k covers elevations from BIOME_THRESHOLDS[k - 1] up to
+// BIOME_THRESHOLDS[k], so the biome is the number of thresholds at or below the elevation
+const int BIOME_COUNT = 11;
+const float BIOME_THRESHOLDS[BIOME_COUNT - 1] = {0.05f, 0.15f, 0.25f, 0.35f, 0.45f, 0.55f, 0.65f, 0.75f, 0.85f,
+                                                 0.95f};
+// deep ocean, shallow ocean, coast, lowlands, desert, foothills, mountain base, hills, mountains, high
+// mountains, peaks; the script's colors rounded to bytes the way the .rgb reader does
+const glm::u8vec3 BIOME_COLORS[BIOME_COUNT] = {
+        {0, 0, 255}, {0, 0, 128}, {0, 255, 0}, {0, 128, 0}, {204, 204, 0}, {128, 128, 0}, {77, 77, 0},
+        {179, 179, 179}, {128, 128, 128}, {204, 204, 204}, {255, 255, 255}};
+
+inline int classifyBiome(float elevation) {
+    int biome = 0;
+    for (float threshold: BIOME_THRESHOLDS)
+        biome += elevation >= threshold;
+    return biome;
+}
+
+// Colors every sample of `heights` by its biome, in parallel over rows
+inline void classifyTerrain(const Grid2D<const float> &heights, Grid2D<glm::u8vec3> &colors) {
+    TRACE_ZONE("classifyTerrain");
+    const int rows = heights.rows(), cols = heights.cols();
+    colors = Grid2D<glm::u8vec3>(rows, cols);
+    ThreadPool::shared().parallelFor(size_t(rows), 16, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+            const float *h = heights.row(int(i));
+            glm::u8vec3 *c = colors.row(int(i));
+            for (int j = 0; j < cols; j++)
+                c[j] = BIOME_COLORS[classifyBiome(h[j])];
+        }
+    });
+}
+
+// Heights and biome colors of a rows x cols terrain
+inline void generateTerrain(const TerrainNoise &settings, int rows, int cols, Grid2D<float> &heights,
+                            Grid2D<glm::u8vec3> &colors) {
+    generateHeights(settings, rows, cols, heights);
+    classifyTerrain(heights, colors);
+}
+
+#endif //RECONSTRUCTION_TERRAINGENERATOR_H
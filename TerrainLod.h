@@ -0,0 +1,282 @@
+#ifndef RECONSTRUCTION_TERRAINLOD_H
+#define RECONSTRUCTION_TERRAINLOD_H
+
+#include <glad.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include "Grid2D.h"
+#include "TerrainQuadtree.h"
+#include "ThreadPool.h"
+#include "shader_m.h"
+
+// Geomipmapping over the quadtree chunks. A chunk at level L draws every 2^L-th sample of the shared
+// full-resolution vertex buffer; the level is the coarsest one whose geometric error, projected at the
+// chunk's distance, stays under a pixel threshold.
+//
+// Cracks: an edge shared with a coarser chunk snaps its extra vertices onto the coarser chunk's samples
+// (the collapsed triangles are dropped), so both chunks draw the same segments along the edge.
+// Popping: every vertex knows the level it disappears at and the height the next coarser level has at
+// its position, and terrain_lod.vs blends towards that height as the vertex approaches the distance select()
+// drops its level at. That distance comes from the errors of the chunks sharing the vertex (the earliest one
+// wins, since an edge vertex goes as soon as either side is coarser), so every chunk moves it the same way.
+// Chunk sizes must be powers of two (chunk origins are then aligned to every level).
+class TerrainLod {
+public:
+    static const int MAX_LEVELS = 16; // must match terrain_lod.vs
+
+    int maxLevel = 0;          // log2 of the chunk size
+    std::vector<int> levels;   // selected level per chunk
+    std::vector<int> chunkMaxLevel;
+
+    TerrainLod() = default;
+
+    TerrainLod(const TerrainLod &) = delete;
+
+    TerrainLod &operator=(const TerrainLod &) = delete;
+
+    ~TerrainLod() {
+        if (morphTexture != 0)
+            glDeleteTextures(1, &morphTexture);
+        if (morphBuffer != 0)
+            glDeleteBuffers(1, &morphBuffer);
+    }
+
+    static int floorPowerOfTwo(int n) {
+        int p = 1;
+        while (p * 2 <= n)
+            p *= 2;
+        return p;
+    }
+
+    // Level at which sample (i, j) is dropped: its number of trailing zero bits, up to maxLevel
+    int vertexLevel(int i, int j) const {
+        int level = 0;
+        while (level < maxLevel && ((i | j) & (1 << level)) == 0)
+            level++;
+        return level;
+    }
+
+    // (normalized height of the next coarser level at sample (i, j), vertexLevel(i, j)). Samples whose
+    // coarser neighbours fall outside the grid are only ever drawn at their own level and do not morph.
+    glm::vec2 morph(const Grid2D<const float> &heights, int i, int j) const {
+        int level = vertexLevel(i, j);
+        float height = heights(i, j);
+        if (level == maxLevel)
+            return glm::vec2(height, float(maxLevel));
+        int step = 1 << level;
+        bool oddRow = (i & step) != 0, oddCol = (j & step) != 0;
+        // parents along the column, the row, or the coarse quad's diagonal (same split as Map::buildIndices)
+        int di = oddRow ? step : 0, dj = oddCol ? step : 0;
+        int i0 = i - di, j0 = oddRow ? j + dj : j - dj;
+        int i1 = i + di, j1 = oddRow ? j - dj : j + dj;
+        if (i1 >= heights.rows() || std::max(j0, j1) >= heights.cols())
+            return glm::vec2(height, float(maxLevel));
+        return glm::vec2(0.5f * (heights(i0, j0) + heights(i1, j1)), float(level));
+    }
+
+    // Finds the normalized height error of every level of every chunk; chunk sizes are powers of two
+    void build(const TerrainQuadtree &tree, const Grid2D<const float> &heights) {
+        const std::vector<TerrainChunk> &chunks = tree.chunks;
+        chunkSize = tree.chunkSize;
+        gridCols = heights.cols();
+        maxLevel = 0;
+        while ((2 << maxLevel) <= chunkSize && maxLevel + 1 < MAX_LEVELS)
+            maxLevel++;
+        chunkGridRows = (heights.rows() - 2) / chunkSize + 1;
+        chunkGridCols = (heights.cols() - 2) / chunkSize + 1;
+        chunkIndex.assign(size_t(chunkGridRows) * chunkGridCols, -1);
+        for (size_t c = 0; c < chunks.size(); c++)
+            chunkIndex[size_t(chunks[c].row / chunkSize) * chunkGridCols + chunks[c].col / chunkSize] = int(c);
+
+        levels.assign(chunks.size(), 0);
+        chunkMaxLevel.assign(chunks.size(), 0);
+        errors.assign(chunks.size() * MAX_LEVELS, 0.0f);
+        ThreadPool::shared().parallelFor(chunks.size(), 1, [&](size_t first, size_t last) {
+            for (size_t c = first; c < last; c++) {
+                const TerrainChunk &chunk = chunks[c];
+                // a partial chunk on the far border only gets the levels that divide it
+                int top = 0;
+                while (top < maxLevel && chunk.rows % (2 << top) == 0 && chunk.cols % (2 << top) == 0)
+                    top++;
+                chunkMaxLevel[c] = top;
+                float *error = &errors[c * MAX_LEVELS];
+                for (int level = 1; level <= top; level++)
+                    error[level] = std::max(error[level - 1], levelError(heights, chunk, 1 << level));
+            }
+        });
+        levelErrors.assign(MAX_LEVELS, 0.0f);
+        for (size_t c = 0; c < chunks.size(); c++)
+            for (int level = 1; level <= chunkMaxLevel[c]; level++)
+                levelErrors[level] = std::max(levelErrors[level], errors[c * MAX_LEVELS + level]);
+        for (int level = 1; level < MAX_LEVELS; level++)
+            levelErrors[level] = std::max(levelErrors[level], levelErrors[level - 1]);
+    }
+
+    // Picks the level of every chunk. `eye` is in model space, `heightScale` turns normalized heights into
+    // model units and `pixelsPerUnit` is the projected size of one unit at distance one (projection[1][1] *
+    // viewport height / 2); a level is accepted when its error covers at most `pixelError` pixels.
+    // Returns whether any chunk changed level.
+    bool select(const std::vector<TerrainChunk> &chunks, const glm::vec3 &eye, float heightScale,
+                float pixelsPerUnit, float pixelError) {
+        const float errorScale = heightScale * pixelsPerUnit;
+        bool changed = false;
+        for (size_t c = 0; c < chunks.size(); c++) {
+            const TerrainChunk &chunk = chunks[c];
+            float distance = glm::length(glm::max(glm::max(chunk.boundsMin - eye, eye - chunk.boundsMax),
+                                                  glm::vec3(0.0f)));
+            const float *error = &errors[c * MAX_LEVELS];
+            int level = 0;
+            while (level < chunkMaxLevel[c] && error[level + 1] * errorScale <= pixelError * distance)
+                level++;
+            changed |= levels[c] != level;
+            levels[c] = level;
+        }
+        return changed;
+    }
+
+    // Largest normalized distance between chunk `c`'s drawn surface and its samples after select(): the
+    // coarsest level along its edges (its own or a neighbour's it snaps to), one more for the morph
+    float drawnError(const std::vector<TerrainChunk> &chunks, size_t c) const {
+        const TerrainChunk &chunk = chunks[c];
+        const int gridRow = chunk.row / chunkSize, gridCol = chunk.col / chunkSize;
+        int step = 1 << levels[c];
+        step = std::max({step, edgeStep(step, gridRow - 1, gridCol), edgeStep(step, gridRow + 1, gridCol),
+                         edgeStep(step, gridRow, gridCol - 1), edgeStep(step, gridRow, gridCol + 1)});
+        int level = 1;
+        while ((1 << level) <= step && level < MAX_LEVELS - 1)
+            level++;
+        // a partial chunk has no errors past its own levels; the map-wide one bounds them
+        return level <= chunkMaxLevel[c] ? errors[c * MAX_LEVELS + level] : levelErrors[level];
+    }
+
+    // Uploads the per-chunk errors terrain_lod.vs morphs with, MAX_LEVELS per chunk grid cell; levels a chunk
+    // never reaches get a huge error, so their vertices only morph for the neighbours that do. Needs a context.
+    void setup(const std::vector<TerrainChunk> &chunks) {
+        std::vector<float> table(size_t(chunkGridRows) * chunkGridCols * MAX_LEVELS, 1e20f);
+        for (size_t c = 0; c < chunks.size(); c++) {
+            float *out = &table[(size_t(chunks[c].row / chunkSize) * chunkGridCols + chunks[c].col / chunkSize) *
+                                MAX_LEVELS];
+            for (int level = 0; level <= chunkMaxLevel[c]; level++)
+                out[level] = errors[c * MAX_LEVELS + level];
+        }
+        if (morphBuffer == 0) {
+            glGenBuffers(1, &morphBuffer);
+            glGenTextures(1, &morphTexture);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, morphBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, GLsizeiptr(table.size() * sizeof(float)), table.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_BUFFER, morphTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, morphBuffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // Binds the error table to texture unit 0 and sets the morph uniforms of terrain_lod.vs; same arguments as
+    // select(), so a vertex has fully morphed by the time select() drops its level
+    void bindMorph(Shader &sh, float heightScale, float pixelsPerUnit, float pixelError) const {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_BUFFER, morphTexture);
+        sh.setInt("chunkErrors", 0);
+        sh.setInt("chunkSize", chunkSize);
+        sh.setIVec2("chunkGrid", chunkGridRows, chunkGridCols);
+        sh.setInt("maxLevel", maxLevel);
+        sh.setFloat("morphScale", heightScale * pixelsPerUnit / pixelError);
+        sh.setFloat("morphRegion", MORPH_REGION);
+    }
+
+    void unbindMorph() const {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // Appends the triangles of chunk `index` at its selected level, stitched to its four neighbours
+    template<typename Index>
+    void emitChunk(const std::vector<TerrainChunk> &chunks, size_t index, std::vector<Index> &out) const {
+        const TerrainChunk &chunk = chunks[index];
+        const int step = 1 << levels[index];
+        const int gridRow = chunk.row / chunkSize, gridCol = chunk.col / chunkSize;
+        // vertex spacing along each edge: the coarser of the two chunks sharing it
+        const int north = edgeStep(step, gridRow - 1, gridCol), south = edgeStep(step, gridRow + 1, gridCol);
+        const int west = edgeStep(step, gridRow, gridCol - 1), east = edgeStep(step, gridRow, gridCol + 1);
+
+        auto vertex = [&](int row, int col) {
+            if (row == 0)
+                col = snap(col, step, north);
+            else if (row == chunk.rows)
+                col = snap(col, step, south);
+            if (col == 0)
+                row = snap(row, step, west);
+            else if (col == chunk.cols)
+                row = snap(row, step, east);
+            return Index(size_t(chunk.row + row) * size_t(gridCols) + size_t(chunk.col + col));
+        };
+        auto triangle = [&out](Index a, Index b, Index d) {
+            if (a != b && b != d && a != d) {
+                out.push_back(a);
+                out.push_back(b);
+                out.push_back(d);
+            }
+        };
+        for (int r = 0; r < chunk.rows; r += step) {
+            for (int c = 0; c < chunk.cols; c += step) {
+                // same split as Map::buildIndices
+                Index topRight = vertex(r, c + step), topLeft = vertex(r, c);
+                Index bottomLeft = vertex(r + step, c), bottomRight = vertex(r + step, c + step);
+                triangle(topRight, topLeft, bottomLeft);
+                triangle(bottomRight, topRight, bottomLeft);
+            }
+        }
+    }
+
+private:
+    static constexpr float MORPH_REGION = 0.3f; // fraction of the range spent blending
+
+    int chunkSize = 64;
+    int gridCols = 0;
+    int chunkGridRows = 0, chunkGridCols = 0;
+    std::vector<int> chunkIndex;     // chunk grid cell -> chunk
+    std::vector<float> errors;       // MAX_LEVELS per chunk, non-decreasing
+    std::vector<float> levelErrors;  // largest error of each level over all chunks
+    GLuint morphBuffer = 0, morphTexture = 0;
+
+    // Largest difference between the samples of a chunk and the surface of its grid at spacing `step`
+    static float levelError(const Grid2D<const float> &heights, const TerrainChunk &chunk, int step) {
+        const float inverseStep = 1.0f / float(step);
+        float error = 0.0f;
+        for (int i = chunk.row; i <= chunk.row + chunk.rows; i++) {
+            int i0 = std::min(chunk.row + (i - chunk.row) / step * step, chunk.row + chunk.rows - step);
+            float u = float(i - i0) * inverseStep;
+            const float *row = heights.row(i), *top = heights.row(i0), *bottom = heights.row(i0 + step);
+            for (int j = chunk.col; j <= chunk.col + chunk.cols; j++) {
+                int j0 = std::min(chunk.col + (j - chunk.col) / step * step, chunk.col + chunk.cols - step);
+                float v = float(j - j0) * inverseStep;
+                float h00 = top[j0], h01 = top[j0 + step], h10 = bottom[j0], h11 = bottom[j0 + step];
+                float surface = u + v <= 1.0f ? h00 + u * (h10 - h00) + v * (h01 - h00)
+                                              : h11 + (1.0f - u) * (h01 - h11) + (1.0f - v) * (h10 - h11);
+                error = std::max(error, std::abs(row[j] - surface));
+            }
+        }
+        return error;
+    }
+
+    int edgeStep(int step, int gridRow, int gridCol) const {
+        if (gridRow < 0 || gridCol < 0 || gridRow >= chunkGridRows || gridCol >= chunkGridCols)
+            return step;
+        int neighbour = chunkIndex[size_t(gridRow) * chunkGridCols + gridCol];
+        return neighbour < 0 ? step : std::max(step, 1 << levels[neighbour]);
+    }
+
+    // Moves an edge offset that is a multiple of `step` to the nearest multiple of `edge` (ties go down)
+    static int snap(int offset, int step, int edge) {
+        if (edge <= step)
+            return offset;
+        return (offset + edge / 2 - 1) / edge * edge;
+    }
+};
+
+#endif //RECONSTRUCTION_TERRAINLOD_H
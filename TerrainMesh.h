@@ -0,0 +1,172 @@
+#ifndef RECONSTRUCTION_TERRAINMESH_H
+#define RECONSTRUCTION_TERRAINMESH_H
+
+#include <glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include "MultiDraw.h"
+#include "shader_m.h"
+
+// Whole-map mesh: one shared vertex per grid sample in an interleaved VBO plus an index buffer
+// behind a single VAO, so the map is uploaded once. It is drawn whole or as a list of index ranges,
+// submitted together as one multi-draw (MultiDraw.h).
+//
+// Vertices are packed into 12 bytes. The grid position is not stored: vertex k of a mesh is grid sample
+// (k / cols, k % cols) from the mesh's origin, and the terrain shaders rebuild it from gl_VertexID and the
+// uniforms setGrid() sets. Heights are normalized to the map's height range and normals octahedral.
+class TerrainMesh {
+public:
+    struct Vertex {
+        glm::u16vec2 height;    // unorm16 (height, height at the next coarser LOD level)
+        glm::i16vec2 normal;    // snorm16 octahedral normal, folded around +y
+        glm::u8vec4 color;      // RGB8, read as normalized floats; alpha is the LOD level the vertex is dropped at
+    };
+
+    static_assert(sizeof(Vertex) == 12, "terrain vertices are 12 bytes");
+
+    // `count` indices starting at index `first`
+    struct Range {
+        size_t first;
+        size_t count;
+    };
+
+    static constexpr GLuint RESTART_INDEX = 0xFFFFFFFFu;
+
+    GLint HEIGHT_ATTRIBUTE = 0, NORMAL_ATTRIBUTE = 1, COLOR_ATTRIBUTE = 2, LEVEL_ATTRIBUTE = 3;
+    bool visible = true;
+
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint ebo = 0;
+    GLenum primitive = GL_TRIANGLES;
+    GLenum indexType = GL_UNSIGNED_INT;
+    GLsizei indexCount = 0;
+    float escala = 1.0f;
+    MultiDraw batch;
+
+    TerrainMesh() = default;
+
+    TerrainMesh(const TerrainMesh &) = delete;
+
+    TerrainMesh &operator=(const TerrainMesh &) = delete;
+
+    ~TerrainMesh() {
+        if (vbo != 0)
+            glDeleteBuffers(1, &vbo);
+        if (ebo != 0)
+            glDeleteBuffers(1, &ebo);
+        if (vao != 0)
+            glDeleteVertexArrays(1, &vao);
+    }
+
+    // `indices` holds `indexCount` elements of `type` (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT); strips restart
+    // at the type's maximum value
+    void setup(const Vertex *vertices, size_t vertexCount, const void *indices, size_t indexCount, GLenum type,
+               GLenum mode = GL_TRIANGLES) {
+        if (vao == 0) {
+            glGenVertexArrays(1, &vao);
+            glGenBuffers(1, &vbo);
+            glGenBuffers(1, &ebo);
+        }
+        glBindVertexArray(vao);
+
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(vertexCount * sizeof(Vertex)), vertices, GL_STATIC_DRAW);
+
+        vertexFormat(HEIGHT_ATTRIBUTE, NORMAL_ATTRIBUTE, COLOR_ATTRIBUTE, LEVEL_ATTRIBUTE);
+
+        // The element buffer binding is VAO state, so it stays bound until the VAO is released
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        size_t indexSize = type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(indexCount * indexSize), indices, GL_STATIC_DRAW);
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        primitive = mode;
+        indexType = type;
+        this->indexCount = static_cast<GLsizei>(indexCount);
+    }
+
+    // Points the attributes of the bound VAO at Vertex fields of the bound array buffer
+    static void vertexFormat(GLint heightAttribute, GLint normalAttribute, GLint colorAttribute,
+                             GLint levelAttribute) {
+        glVertexAttribPointer(heightAttribute, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(Vertex),
+                              (void *) offsetof(Vertex, height));
+        glEnableVertexAttribArray(heightAttribute);
+        glVertexAttribPointer(normalAttribute, 2, GL_SHORT, GL_TRUE, sizeof(Vertex),
+                              (void *) offsetof(Vertex, normal));
+        glEnableVertexAttribArray(normalAttribute);
+        glVertexAttribPointer(colorAttribute, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex),
+                              (void *) offsetof(Vertex, color));
+        glEnableVertexAttribArray(colorAttribute);
+        // the alpha byte again, as an integer-valued float
+        glVertexAttribPointer(levelAttribute, 1, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(Vertex),
+                              (void *) (offsetof(Vertex, color) + 3));
+        glEnableVertexAttribArray(levelAttribute);
+    }
+
+    static uint16_t packHeight(float normalized) {
+        return uint16_t(std::clamp(normalized, 0.0f, 1.0f) * 65535.0f + 0.5f);
+    }
+
+    // Uniforms the terrain shaders rebuild positions from: vertex k is grid sample
+    // (originRow + k / cols, originCol + k % cols), clamped to (lastRow, lastCol), at
+    // (row * spacing, height * (maxHeight - minHeight) + minHeight, col * spacing)
+    static void setGrid(Shader &sh, int originRow, int originCol, int cols, int lastRow, int lastCol, float spacing,
+                        float minHeight, float maxHeight) {
+        sh.setIVec2("gridOrigin", originRow, originCol);
+        sh.setInt("gridCols", cols);
+        sh.setIVec2("gridLast", lastRow, lastCol);
+        sh.setFloat("spacing", spacing);
+        sh.setFloat("heightScale", maxHeight - minHeight);
+        sh.setFloat("heightOffset", minHeight);
+    }
+
+    // Replaces the index buffer (same type and primitive), leaving the vertices as they are
+    void updateIndices(const void *indices, size_t indexCount) {
+        size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+        glBindVertexArray(vao);
+        // orphan the old storage so the driver does not wait for draws still reading it
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(indexCount * indexSize), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, GLsizeiptr(indexCount * indexSize), indices);
+        glBindVertexArray(0);
+        this->indexCount = static_cast<GLsizei>(indexCount);
+    }
+
+    void display(Shader &sh, float cambio_escala) {
+        Range all{0, size_t(indexCount)};
+        display(sh, cambio_escala, &all, 1);
+    }
+
+    void display(Shader &sh, float cambio_escala, const Range *ranges, size_t rangeCount) {
+        escala = cambio_escala;
+        glm::mat4 model = glm::mat4(1.0);
+        model = scale(model, glm::vec3(escala));
+        sh.setMat4("model", model);
+
+        if (visible && indexCount > 0 && rangeCount > 0) {
+            glBindVertexArray(vao);
+            if (primitive == GL_TRIANGLE_STRIP) {
+                glEnable(GL_PRIMITIVE_RESTART);
+                glPrimitiveRestartIndex(indexType == GL_UNSIGNED_SHORT ? 0xFFFF : RESTART_INDEX);
+            }
+            batch.clear();
+            for (size_t k = 0; k < rangeCount; k++)
+                batch.addElements(ranges[k].count, ranges[k].first);
+            batch.drawElements(primitive, indexType);
+            if (primitive == GL_TRIANGLE_STRIP)
+                glDisable(GL_PRIMITIVE_RESTART);
+            glBindVertexArray(0);
+        }
+    }
+};
+
+#endif //RECONSTRUCTION_TERRAINMESH_H
@@ -0,0 +1,224 @@
+#ifndef RECONSTRUCTION_TERRAINOCCLUSION_H
+#define RECONSTRUCTION_TERRAINOCCLUSION_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include "Grid2D.h"
+#include "TerrainQuadtree.h"
+#include "ThreadPool.h"
+
+// Software occlusion culling for the heightfield. Every chunk is split into up to CELLS x CELLS cells, and a
+// cell's occluder is the box from the map's lowest height up to the cell's lowest sample. Nothing of that box
+// is above the terrain: the surface over the cell, and over its edges, is never lower than its samples. So
+// when the eye is above the terrain, whatever the box hides, the terrain hides too. The front faces of the
+// nearest chunks' boxes are rasterized into a small depth buffer, then a chunk whose bounding box is behind
+// that depth at every pixel it covers is culled.
+//
+// Box faces on the map's outer edge hide nothing (the terrain has no walls there), so they are skipped.
+// Meshes that only approximate the grid (LOD levels, simplification) may dip below the samples; callers lower
+// the occluders by that error.
+class TerrainOcclusion {
+public:
+    static const int CELLS = 4;             // cells per chunk side
+    static const int WIDTH = 256;           // depth buffer width; the height follows the aspect ratio
+
+    int maxOccluders = 96;                  // nearest chunks rasterized per frame
+
+    // Lowest and highest normalized sample of every cell
+    void build(const Grid2D<const float> &heights, const std::vector<TerrainChunk> &chunks) {
+        gridRows = heights.rows();
+        gridCols = heights.cols();
+        cells.assign(chunks.size() * CELLS * CELLS, Cell());
+        ThreadPool::shared().parallelFor(chunks.size(), 4, [&](size_t first, size_t last) {
+            for (size_t c = first; c < last; c++) {
+                const TerrainChunk &chunk = chunks[c];
+                for (int a = 0; a < CELLS; a++) {
+                    for (int b = 0; b < CELLS; b++) {
+                        Cell &cell = cells[c * CELLS * CELLS + size_t(a) * CELLS + b];
+                        cell.row0 = chunk.row + chunk.rows * a / CELLS;
+                        cell.row1 = chunk.row + chunk.rows * (a + 1) / CELLS;
+                        cell.col0 = chunk.col + chunk.cols * b / CELLS;
+                        cell.col1 = chunk.col + chunk.cols * (b + 1) / CELLS;
+                        if (cell.row0 == cell.row1 || cell.col0 == cell.col1)
+                            continue; // chunks narrower than CELLS quads have fewer cells
+                        cell.heightMin = heights(cell.row0, cell.col0);
+                        cell.heightMax = cell.heightMin;
+                        for (int i = cell.row0; i <= cell.row1; i++) {
+                            const float *row = heights.row(i);
+                            for (int j = cell.col0; j <= cell.col1; j++) {
+                                cell.heightMin = std::min(cell.heightMin, row[j]);
+                                cell.heightMax = std::max(cell.heightMax, row[j]);
+                            }
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    bool empty() const {
+        return cells.empty();
+    }
+
+    // Clears the depth buffer. `mvp` maps model space to clip space, `aspect` is the viewport's width over its
+    // height, and a sample (i, j) of normalized height h sits at (i * spacing, h * heightScale + heightOffset,
+    // j * spacing) in model space
+    void begin(const glm::mat4 &mvp, float aspect, float spacing, float heightScale, float heightOffset) {
+        this->mvp = mvp;
+        this->spacing = spacing;
+        this->heightScale = heightScale;
+        this->heightOffset = heightOffset;
+        width = WIDTH;
+        height = std::clamp(int(std::lround(WIDTH / std::max(aspect, 1e-3f))), 1, 4 * WIDTH);
+        depth.assign(size_t(width) * height, 1.0f);
+    }
+
+    // Rasterizes the cells of chunk `c` as seen from the model-space `eye`, lowered by `slack` (normalized)
+    void addOccluder(size_t c, const glm::vec3 &eye, float slack) {
+        const float bottom = std::min(heightOffset, heightOffset + heightScale) - std::abs(heightScale) * slack;
+        for (size_t k = c * CELLS * CELLS; k < (c + 1) * CELLS * CELLS; k++) {
+            const Cell &cell = cells[k];
+            if (cell.row0 == cell.row1 || cell.col0 == cell.col1)
+                continue;
+            // the lowest point of the cell's surface, whichever way the heights are scaled
+            const float top = (heightScale >= 0.0f ? cell.heightMin : cell.heightMax) * heightScale + heightOffset -
+                              std::abs(heightScale) * slack;
+            if (top <= bottom)
+                continue;
+            const float x0 = float(cell.row0) * spacing, x1 = float(cell.row1) * spacing;
+            const float z0 = float(cell.col0) * spacing, z1 = float(cell.col1) * spacing;
+            // front faces only: together they cover the box's whole outline
+            if (eye.y > top)
+                quad({x0, top, z0}, {x1, top, z0}, {x1, top, z1}, {x0, top, z1});
+            if (eye.x < x0 && cell.row0 > 0)
+                quad({x0, bottom, z0}, {x0, top, z0}, {x0, top, z1}, {x0, bottom, z1});
+            if (eye.x > x1 && cell.row1 < gridRows - 1)
+                quad({x1, bottom, z0}, {x1, top, z0}, {x1, top, z1}, {x1, bottom, z1});
+            if (eye.z < z0 && cell.col0 > 0)
+                quad({x0, bottom, z0}, {x0, top, z0}, {x1, top, z0}, {x1, bottom, z0});
+            if (eye.z > z1 && cell.col1 < gridCols - 1)
+                quad({x0, bottom, z1}, {x0, top, z1}, {x1, top, z1}, {x1, bottom, z1});
+        }
+    }
+
+    // Makes the buffer conservative after the occluders are in: every pixel takes the farthest depth around it,
+    // so a pixel an occluder only partly covers does not hide anything
+    void finish() {
+        std::vector<float> across(depth.size());
+        for (int y = 0; y < height; y++) {
+            const float *in = &depth[size_t(y) * width];
+            float *out = &across[size_t(y) * width];
+            for (int x = 0; x < width; x++)
+                out[x] = std::max({in[std::max(x - 1, 0)], in[x], in[std::min(x + 1, width - 1)]});
+        }
+        for (int y = 0; y < height; y++) {
+            const float *above = &across[size_t(std::max(y - 1, 0)) * width];
+            const float *row = &across[size_t(y) * width];
+            const float *below = &across[size_t(std::min(y + 1, height - 1)) * width];
+            float *out = &depth[size_t(y) * width];
+            for (int x = 0; x < width; x++)
+                out[x] = std::max({above[x], row[x], below[x]});
+        }
+    }
+
+    // Whether the model-space box is behind the occluders wherever it projects
+    bool occluded(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) const {
+        float minX = float(width), maxX = 0.0f, minY = float(height), maxY = 0.0f, nearest = 1.0f;
+        for (int k = 0; k < 8; k++) {
+            glm::vec4 clip = mvp * glm::vec4(k & 1 ? boundsMax.x : boundsMin.x, k & 2 ? boundsMax.y : boundsMin.y,
+                                             k & 4 ? boundsMax.z : boundsMin.z, 1.0f);
+            if (clip.z < -clip.w)
+                return false; // crosses the near plane
+            glm::vec3 screen = toScreen(clip);
+            minX = std::min(minX, screen.x);
+            maxX = std::max(maxX, screen.x);
+            minY = std::min(minY, screen.y);
+            maxY = std::max(maxY, screen.y);
+            nearest = std::min(nearest, screen.z);
+        }
+        const int x0 = std::max(int(std::floor(minX)), 0), x1 = std::min(int(std::ceil(maxX)), width);
+        const int y0 = std::max(int(std::floor(minY)), 0), y1 = std::min(int(std::ceil(maxY)), height);
+        if (x0 >= x1 || y0 >= y1)
+            return false;
+        for (int y = y0; y < y1; y++) {
+            const float *row = &depth[size_t(y) * width];
+            for (int x = x0; x < x1; x++)
+                if (row[x] >= nearest)
+                    return false;
+        }
+        return true;
+    }
+
+private:
+    struct Cell {
+        int row0 = 0, row1 = 0, col0 = 0, col1 = 0;   // sample range, inclusive
+        float heightMin = 0.0f, heightMax = 0.0f;
+    };
+
+    std::vector<Cell> cells;                // CELLS * CELLS per chunk
+    int gridRows = 0, gridCols = 0;
+    glm::mat4 mvp = glm::mat4(1.0f);
+    float spacing = 1.0f, heightScale = 1.0f, heightOffset = 0.0f;
+    int width = 0, height = 0;
+    std::vector<float> depth;               // NDC depth, 1 where nothing was drawn
+
+    glm::vec3 toScreen(const glm::vec4 &clip) const {
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        return {(ndc.x * 0.5f + 0.5f) * float(width), (ndc.y * 0.5f + 0.5f) * float(height), ndc.z};
+    }
+
+    // Clips the quad against the near plane and rasterizes what is left as a fan
+    void quad(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, const glm::vec3 &d) {
+        const glm::vec4 in[4] = {mvp * glm::vec4(a, 1.0f), mvp * glm::vec4(b, 1.0f), mvp * glm::vec4(c, 1.0f),
+                                 mvp * glm::vec4(d, 1.0f)};
+        glm::vec4 clipped[5];
+        int count = 0;
+        for (int k = 0; k < 4; k++) {
+            const glm::vec4 &p = in[k], &q = in[(k + 1) % 4];
+            const float dp = p.z + p.w, dq = q.z + q.w; // >= 0 in front of the near plane
+            if (dp >= 0.0f)
+                clipped[count++] = p;
+            if ((dp >= 0.0f) != (dq >= 0.0f))
+                clipped[count++] = p + (q - p) * (dp / (dp - dq));
+        }
+        if (count < 3)
+            return;
+        glm::vec3 screen[5];
+        for (int k = 0; k < count; k++)
+            screen[k] = toScreen(clipped[k]);
+        for (int k = 1; k + 1 < count; k++)
+            triangle(screen[0], screen[k], screen[k + 1]);
+    }
+
+    // Keeps the nearest depth at every pixel centre the triangle covers; depth is affine in screen space
+    void triangle(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c) {
+        const float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if (std::abs(area) < 1e-8f)
+            return;
+        const int x0 = std::max(int(std::floor(std::min({a.x, b.x, c.x}))), 0);
+        const int x1 = std::min(int(std::ceil(std::max({a.x, b.x, c.x}))), width);
+        const int y0 = std::max(int(std::floor(std::min({a.y, b.y, c.y}))), 0);
+        const int y1 = std::min(int(std::ceil(std::max({a.y, b.y, c.y}))), height);
+        const float inverseArea = 1.0f / area;
+        for (int y = y0; y < y1; y++) {
+            const float py = float(y) + 0.5f;
+            float *row = &depth[size_t(y) * width];
+            for (int x = x0; x < x1; x++) {
+                const float px = float(x) + 0.5f;
+                // barycentric weights of b and c; the signs follow the winding, so both windings fill
+                const float wb = ((px - a.x) * (c.y - a.y) - (py - a.y) * (c.x - a.x)) * inverseArea;
+                const float wc = ((b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x)) * inverseArea;
+                if (wb < 0.0f || wc < 0.0f || wb + wc > 1.0f)
+                    continue;
+                const float z = std::max(a.z + wb * (b.z - a.z) + wc * (c.z - a.z), -1.0f);
+                row[x] = std::min(row[x], z);
+            }
+        }
+    }
+};
+
+#endif //RECONSTRUCTION_TERRAINOCCLUSION_H
@@ -0,0 +1,119 @@
+#ifndef RECONSTRUCTION_TERRAINQUADTREE_H
+#define RECONSTRUCTION_TERRAINQUADTREE_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include "Frustum.h"
+
+// Fixed-size block of grid quads; bounds are in model space
+struct TerrainChunk {
+    int row, col;           // first quad
+    int rows, cols;         // quads in the chunk
+    float heightMin, heightMax; // normalized height range of the chunk's samples
+    glm::vec3 boundsMin, boundsMax;
+    size_t indexOffset = 0; // first index of the chunk in the terrain index buffer
+    size_t indexCount = 0;
+};
+
+// `count` consecutive chunks starting at `first`
+struct ChunkRun {
+    int first;
+    int count;
+};
+
+// Quadtree over the chunk grid. Chunks are stored in depth-first order, so every node covers a
+// contiguous run [firstChunk, firstChunk + chunkCount) and, with indices laid out in the same order,
+// a contiguous range of the index buffer.
+class TerrainQuadtree {
+public:
+    struct Node {
+        glm::vec3 boundsMin, boundsMax;
+        int firstChunk = 0, chunkCount = 0;
+        int children[4] = {-1, -1, -1, -1};
+    };
+
+    std::vector<TerrainChunk> chunks;
+    std::vector<Node> nodes;
+    int chunkSize = 64;
+
+    // Splits a rows x cols sample grid ((rows - 1) x (cols - 1) quads) into chunkSize x chunkSize quad chunks
+    void build(int rows, int cols, int size) {
+        chunkSize = size;
+        chunks.clear();
+        nodes.clear();
+        int chunkRows = (rows - 2) / chunkSize + 1, chunkCols = (cols - 2) / chunkSize + 1;
+        addNode(0, 0, chunkRows, chunkCols, rows - 1, cols - 1);
+    }
+
+    // Bounds of every chunk must be set before calling this
+    void updateBounds() {
+        for (int n = int(nodes.size()) - 1; n >= 0; n--) {
+            Node &node = nodes[n];
+            node.boundsMin = chunks[node.firstChunk].boundsMin;
+            node.boundsMax = chunks[node.firstChunk].boundsMax;
+            for (int k = node.firstChunk + 1; k < node.firstChunk + node.chunkCount; k++) {
+                node.boundsMin = glm::min(node.boundsMin, chunks[k].boundsMin);
+                node.boundsMax = glm::max(node.boundsMax, chunks[k].boundsMax);
+            }
+        }
+    }
+
+    // Calls emit(firstChunk, chunkCount) for runs of chunks inside or touching the frustum; a node that
+    // is entirely inside is emitted as one run without testing its children
+    template<typename Emit>
+    void cull(const Frustum &frustum, Emit &&emit) const {
+        if (!nodes.empty())
+            cullNode(0, frustum, emit);
+    }
+
+private:
+    int addNode(int chunkRow, int chunkCol, int chunkRows, int chunkCols, int quadRows, int quadCols) {
+        int index = int(nodes.size());
+        nodes.emplace_back();
+        nodes[index].firstChunk = int(chunks.size());
+        if (chunkRows == 1 && chunkCols == 1) {
+            TerrainChunk chunk{};
+            chunk.row = chunkRow * chunkSize;
+            chunk.col = chunkCol * chunkSize;
+            chunk.rows = std::min(chunkSize, quadRows - chunk.row);
+            chunk.cols = std::min(chunkSize, quadCols - chunk.col);
+            chunks.push_back(chunk);
+        } else {
+            int halfRows = (chunkRows + 1) / 2, halfCols = (chunkCols + 1) / 2;
+            int child = 0;
+            for (int r = 0; r < 2; r++) {
+                for (int c = 0; c < 2; c++) {
+                    int rowsHere = r == 0 ? halfRows : chunkRows - halfRows;
+                    int colsHere = c == 0 ? halfCols : chunkCols - halfCols;
+                    if (rowsHere <= 0 || colsHere <= 0)
+                        continue;
+                    int node = addNode(chunkRow + r * halfRows, chunkCol + c * halfCols, rowsHere, colsHere,
+                                       quadRows, quadCols);
+                    nodes[index].children[child++] = node;
+                }
+            }
+        }
+        nodes[index].chunkCount = int(chunks.size()) - nodes[index].firstChunk;
+        return index;
+    }
+
+    template<typename Emit>
+    void cullNode(int index, const Frustum &frustum, Emit &emit) const {
+        const Node &node = nodes[index];
+        Frustum::Containment containment = frustum.classify(node.boundsMin, node.boundsMax);
+        if (containment == Frustum::OUTSIDE)
+            return;
+        if (containment == Frustum::INSIDE || node.children[0] < 0) {
+            emit(node.firstChunk, node.chunkCount);
+            return;
+        }
+        for (int child: node.children)
+            if (child >= 0)
+                cullNode(child, frustum, emit);
+    }
+};
+
+#endif //RECONSTRUCTION_TERRAINQUADTREE_H
@@ -0,0 +1,231 @@
+#ifndef RECONSTRUCTION_TERRAINRTIN_H
+#define RECONSTRUCTION_TERRAINRTIN_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+#include "Grid2D.h"
+#include "TerrainQuadtree.h"
+#include "ThreadPool.h"
+
+// Right-triangulated irregular network (the Martini scheme) over square power-of-two tiles. build() runs once
+// per heightmap and stores, at every triangle's hypotenuse midpoint, the largest vertical distance between
+// the triangle and the samples it covers, raised to the errors of its sub-triangles. A mesh for any error
+// bound is then a top-down walk that splits a triangle while that value is above the bound, so every sample
+// is within the bound of the mesh; flat regions end up as a few large triangles.
+//
+// Every chunk is covered by one tile (or, for partial chunks on the far border, by a few smaller ones).
+// Samples shared by two tiles get the larger of their two errors and tile corners are never dropped, so
+// neighbouring tiles split their shared edge the same way and the mesh has no cracks.
+class TerrainRtin {
+public:
+    // Square of size x size quads whose errors start at errorOffset
+    struct Tile {
+        int row, col;
+        int size;
+        size_t errorOffset;
+    };
+
+    // Builds the error pyramid of every tile; chunks must be in the quadtree's order
+    void build(const TerrainQuadtree &tree, const Grid2D<const float> &heights) {
+        const std::vector<TerrainChunk> &chunks = tree.chunks;
+        gridCols = heights.cols();
+        tiles.clear();
+        chunkTiles.assign(chunks.size() + 1, 0);
+        for (size_t c = 0; c < chunks.size(); c++) {
+            chunkTiles[c] = tiles.size();
+            addTiles(chunks[c].row, chunks[c].col, chunks[c].rows, chunks[c].cols);
+        }
+        chunkTiles[chunks.size()] = tiles.size();
+        size_t errorCount = 0;
+        for (Tile &tile: tiles) {
+            tile.errorOffset = errorCount;
+            errorCount += size_t(tile.size + 1) * (tile.size + 1);
+        }
+        errors.assign(errorCount, 0.0f);
+
+        // propagate within each tile, then share the border errors until the tiles agree
+        std::vector<float> shared(size_t(heights.rows()) * heights.cols());
+        for (bool measure = true;; measure = false) {
+            ThreadPool::shared().parallelFor(tiles.size(), 1, [&](size_t first, size_t last) {
+                for (size_t t = first; t < last; t++)
+                    propagate(tiles[t], heights, measure);
+            });
+            std::fill(shared.begin(), shared.end(), 0.0f);
+            for (const Tile &tile: tiles) {
+                forEachBorderSample(tile, [&](int x, int y) {
+                    float &value = shared[sampleIndex(tile, x, y)];
+                    bool corner = (x == 0 || x == tile.size) && (y == 0 || y == tile.size);
+                    value = corner ? std::numeric_limits<float>::infinity() : std::max(value, error(tile, x, y));
+                });
+            }
+            bool changed = false;
+            for (const Tile &tile: tiles) {
+                forEachBorderSample(tile, [&](int x, int y) {
+                    float value = shared[sampleIndex(tile, x, y)];
+                    if (error(tile, x, y) < value) {
+                        errors[tile.errorOffset + size_t(y) * (tile.size + 1) + x] = value;
+                        changed = true;
+                    }
+                });
+            }
+            if (!changed)
+                break;
+        }
+    }
+
+    // Number of indices the triangles of chunk `chunk` take at the normalized error bound `maxError`
+    size_t indexCount(size_t chunk, float maxError) const {
+        size_t count = 0;
+        for (size_t t = chunkTiles[chunk]; t < chunkTiles[chunk + 1]; t++)
+            triangulate(tiles[t], maxError, [&count](size_t, size_t, size_t) {
+                count += 3;
+            });
+        return count;
+    }
+
+    // Writes the triangles counted by indexCount() as grid vertex indices
+    template<typename Index>
+    void buildIndices(size_t chunk, float maxError, Index *out) const {
+        for (size_t t = chunkTiles[chunk]; t < chunkTiles[chunk + 1]; t++)
+            triangulate(tiles[t], maxError, [&out](size_t a, size_t b, size_t c) {
+                out[0] = Index(a);
+                out[1] = Index(b);
+                out[2] = Index(c);
+                out += 3;
+            });
+    }
+
+private:
+    int gridCols = 0;
+    std::vector<Tile> tiles;
+    std::vector<size_t> chunkTiles; // tiles of chunk c are [chunkTiles[c], chunkTiles[c + 1])
+    std::vector<float> errors;      // (size + 1)^2 per tile, row-major in tile coordinates
+
+    // Covers a rows x cols quad rectangle with the largest power-of-two squares that fit
+    void addTiles(int row, int col, int rows, int cols) {
+        if (rows <= 0 || cols <= 0)
+            return;
+        int size = 1;
+        while (size * 2 <= std::min(rows, cols))
+            size *= 2;
+        int tileRows = rows / size, tileCols = cols / size;
+        for (int r = 0; r < tileRows; r++)
+            for (int c = 0; c < tileCols; c++)
+                tiles.push_back({row + r * size, col + c * size, size, 0});
+        addTiles(row, col + tileCols * size, tileRows * size, cols - tileCols * size);
+        addTiles(row + tileRows * size, col, rows - tileRows * size, cols);
+    }
+
+    size_t sampleIndex(const Tile &tile, int x, int y) const {
+        return size_t(tile.row + y) * size_t(gridCols) + size_t(tile.col + x);
+    }
+
+    float error(const Tile &tile, int x, int y) const {
+        return errors[tile.errorOffset + size_t(y) * (tile.size + 1) + x];
+    }
+
+    template<typename Visit>
+    static void forEachBorderSample(const Tile &tile, Visit &&visit) {
+        for (int k = 0; k <= tile.size; k++) {
+            visit(k, 0);
+            visit(k, tile.size);
+            if (k > 0 && k < tile.size) {
+                visit(0, k);
+                visit(tile.size, k);
+            }
+        }
+    }
+
+    // Bottom-up over all triangles of the tile, smallest first; x is the column and y the row. Errors only
+    // grow, so running it again (without `measure`) after the border exchange carries the raised values up.
+    void propagate(const Tile &tile, const Grid2D<const float> &heights, bool measure) {
+        const int size = tile.size, stride = size + 1;
+        float *error = &errors[tile.errorOffset];
+        auto height = [&](int x, int y) {
+            return heights(tile.row + y, tile.col + x);
+        };
+        const int smallest = size * size;
+        const int triangles = smallest * 2 - 2;
+        const int lastLevel = triangles - smallest;
+        for (int i = triangles - 1; i >= 0; i--) {
+            // walk the triangle's id down from one of the two root triangles to find its corners
+            int id = i + 2;
+            int ax = 0, ay = 0, bx = 0, by = 0, cx = 0, cy = 0;
+            if (id & 1) {
+                bx = by = cx = size;
+            } else {
+                ax = ay = cy = size;
+            }
+            while ((id >>= 1) > 1) {
+                int mx = (ax + bx) >> 1, my = (ay + by) >> 1;
+                if (id & 1) {
+                    bx = ax;
+                    by = ay;
+                    ax = cx;
+                    ay = cy;
+                } else {
+                    ax = bx;
+                    ay = by;
+                    bx = cx;
+                    by = cy;
+                }
+                cx = mx;
+                cy = my;
+            }
+            int mx = (ax + bx) >> 1, my = (ay + by) >> 1;
+            float &middle = error[my * stride + mx];
+            if (measure)
+                middle = std::max(middle, triangleError(height, ax, ay, bx, by, cx, cy));
+            if (i < lastLevel) {
+                middle = std::max(middle, error[((ay + cy) >> 1) * stride + ((ax + cx) >> 1)]);
+                middle = std::max(middle, error[((by + cy) >> 1) * stride + ((bx + cx) >> 1)]);
+            }
+        }
+    }
+
+    // Largest vertical distance between the triangle's plane and the samples inside it
+    template<typename Height>
+    static float triangleError(Height &height, int ax, int ay, int bx, int by, int cx, int cy) {
+        const int area = (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+        const float ha = height(ax, ay), hb = height(bx, by), hc = height(cx, cy);
+        const float inverseArea = 1.0f / float(area);
+        float error = 0.0f;
+        for (int y = std::min({ay, by, cy}); y <= std::max({ay, by, cy}); y++) {
+            for (int x = std::min({ax, bx, cx}); x <= std::max({ax, bx, cx}); x++) {
+                // barycentric weights scaled by the doubled area; all share its sign inside the triangle
+                int wa = (bx - x) * (cy - y) - (by - y) * (cx - x);
+                int wb = (cx - x) * (ay - y) - (cy - y) * (ax - x);
+                int wc = area - wa - wb;
+                if ((area > 0 && (wa < 0 || wb < 0 || wc < 0)) || (area < 0 && (wa > 0 || wb > 0 || wc > 0)))
+                    continue;
+                float surface = (float(wa) * ha + float(wb) * hb + float(wc) * hc) * inverseArea;
+                error = std::max(error, std::abs(surface - height(x, y)));
+            }
+        }
+        return error;
+    }
+
+    // Calls emit(a, b, c) with grid vertex indices for every triangle of the tile at the error bound
+    template<typename Emit>
+    void triangulate(const Tile &tile, float maxError, Emit &&emit) const {
+        split(tile, maxError, emit, 0, 0, tile.size, tile.size, tile.size, 0);
+        split(tile, maxError, emit, tile.size, tile.size, 0, 0, 0, tile.size);
+    }
+
+    // Triangle with hypotenuse a-b and right angle at c
+    template<typename Emit>
+    void split(const Tile &tile, float maxError, Emit &emit, int ax, int ay, int bx, int by, int cx, int cy) const {
+        int mx = (ax + bx) >> 1, my = (ay + by) >> 1;
+        if (std::abs(ax - cx) + std::abs(ay - cy) > 1 && error(tile, mx, my) > maxError) {
+            split(tile, maxError, emit, cx, cy, ax, ay, mx, my);
+            split(tile, maxError, emit, bx, by, cx, cy, mx, my);
+        } else {
+            emit(sampleIndex(tile, ax, ay), sampleIndex(tile, bx, by), sampleIndex(tile, cx, cy));
+        }
+    }
+};
+
+#endif //RECONSTRUCTION_TERRAINRTIN_H
@@ -0,0 +1,142 @@
+#ifndef RECONSTRUCTION_TEXTGRIDPARSER_H
+#define RECONSTRUCTION_TEXTGRIDPARSER_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "ThreadPool.h"
+
+// Parallel parser for the legacy whitespace separated grids (.e holds one value per sample, .rgb three).
+// The file is read in one shot, cut into byte ranges on line boundaries, every range counts its
+// non-blank lines to learn which row it starts at, and then all ranges parse straight into the
+// caller's preallocated rows. Nothing is allocated per line or per value.
+struct TextGridResult {
+    bool opened = false;
+    size_t values = 0;
+};
+
+inline bool isGridSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+// Parses one number starting at `first`; returns the position after it, or `first` when there is none
+inline const char *parseGridFloat(const char *first, const char *last, float &value) {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    if (first < last && *first == '+')
+        ++first;
+    auto result = std::from_chars(first, last, value);
+    return result.ec == std::errc() ? result.ptr : first;
+#else
+    // strtof needs a terminator; every line of the grid ends in whitespace or the file's trailing
+    // null byte, so it never reads past the buffer
+    char *end = nullptr;
+    value = std::strtof(first, &end);
+    return end != nullptr && end <= last ? end : first;
+#endif
+}
+
+// `store(row, index, value)` receives the values of every row in order, index = col * components + component;
+// extra values on a line and extra lines are ignored.
+template<typename Store>
+TextGridResult parseTextGrid(const std::string &path, int rows, int cols, int components, Store store,
+                             ThreadPool &pool = ThreadPool::shared()) {
+    TextGridResult result;
+    std::vector<char> text;
+    {
+        FILE *file = std::fopen(path.c_str(), "rb");
+        if (file == nullptr)
+            return result;
+        std::fseek(file, 0, SEEK_END);
+        long length = std::ftell(file);
+        std::fseek(file, 0, SEEK_SET);
+        text.resize(length > 0 ? size_t(length) + 1 : 1);
+        size_t got = length > 0 ? std::fread(text.data(), 1, size_t(length), file) : 0;
+        std::fclose(file);
+        text[got] = '\0';
+        text.resize(got + 1);
+    }
+    result.opened = true;
+
+    const char *begin = text.data();
+    const char *end = text.data() + text.size() - 1;
+    const size_t rowValues = size_t(cols) * components;
+
+    // Split into about four ranges per thread, each starting right after a newline
+    const size_t minimumRange = 1 << 16;
+    size_t rangeCount = std::max<size_t>(1, std::min<size_t>(size_t(pool.size()) * 4,
+                                                            size_t(end - begin) / minimumRange));
+    std::vector<const char *> cuts(rangeCount + 1);
+    cuts[0] = begin;
+    cuts[rangeCount] = end;
+    for (size_t k = 1; k < rangeCount; k++) {
+        const char *cut = begin + size_t(end - begin) * k / rangeCount;
+        if (cut < cuts[k - 1])
+            cut = cuts[k - 1];
+        const char *newline = static_cast<const char *>(std::memchr(cut, '\n', size_t(end - cut)));
+        cuts[k] = newline != nullptr ? newline + 1 : end;
+    }
+
+    auto forEachLine = [](const char *first, const char *last, auto &&visit) {
+        while (first < last) {
+            const char *newline = static_cast<const char *>(std::memchr(first, '\n', size_t(last - first)));
+            const char *lineEnd = newline != nullptr ? newline : last;
+            const char *p = first;
+            while (p < lineEnd && isGridSpace(*p))
+                ++p;
+            if (p < lineEnd)
+                visit(p, lineEnd);
+            first = lineEnd + 1;
+        }
+    };
+
+    // Pass 1: rows per range, turned into the first row of every range
+    std::vector<size_t> firstRow(rangeCount + 1, 0);
+    pool.parallelFor(rangeCount, 1, [&](size_t first, size_t last) {
+        for (size_t k = first; k < last; k++) {
+            size_t lines = 0;
+            forEachLine(cuts[k], cuts[k + 1], [&lines](const char *, const char *) { lines++; });
+            firstRow[k + 1] = lines;
+        }
+    });
+    for (size_t k = 1; k <= rangeCount; k++)
+        firstRow[k] += firstRow[k - 1];
+
+    // Pass 2: parse every range into its rows
+    std::vector<size_t> parsed(rangeCount, 0);
+    pool.parallelFor(rangeCount, 1, [&](size_t first, size_t last) {
+        for (size_t k = first; k < last; k++) {
+            size_t row = firstRow[k];
+            size_t count = 0;
+            forEachLine(cuts[k], cuts[k + 1], [&](const char *p, const char *lineEnd) {
+                if (row < size_t(rows)) {
+                    size_t n = 0;
+                    while (p < lineEnd && n < rowValues) {
+                        float value;
+                        const char *next = parseGridFloat(p, lineEnd, value);
+                        if (next == p)
+                            break;
+                        store(row, n, value);
+                        n++;
+                        p = next;
+                        while (p < lineEnd && isGridSpace(*p))
+                            ++p;
+                    }
+                    count += n;
+                }
+                row++;
+            });
+            parsed[k] = count;
+        }
+    });
+
+    for (size_t count: parsed)
+        result.values += count;
+    return result;
+}
+
+#endif //RECONSTRUCTION_TEXTGRIDPARSER_H
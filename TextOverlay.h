@@ -0,0 +1,148 @@
+#ifndef RECONSTRUCTION_TEXTOVERLAY_H
+#define RECONSTRUCTION_TEXTOVERLAY_H
+
+#include <glad.h>
+
+#include <glm/glm.hpp>
+
+#include <cctype>
+#include <string>
+#include <vector>
+#include "shader_m.h"
+
+// Screen-space text in a built-in 5x7 pixel font (ASCII 32-95; lowercase is drawn as uppercase), drawn over
+// the frame on a translucent background. Meant for debug readouts such as the profiler table.
+class TextOverlay {
+public:
+    static const int GLYPH_WIDTH = 6, GLYPH_HEIGHT = 8; // 5x7 glyph plus one pixel of spacing
+    static const int FIRST_GLYPH = 32, GLYPH_COUNT = 64;
+
+    Shader shader{"../shaders/text_overlay.vs", "../shaders/text_overlay.fs"};
+
+    TextOverlay() = default;
+
+    TextOverlay(const TextOverlay &) = delete;
+
+    TextOverlay &operator=(const TextOverlay &) = delete;
+
+    ~TextOverlay() {
+        if (vao != 0) {
+            glDeleteVertexArrays(1, &vao);
+            glDeleteBuffers(1, &vbo);
+            glDeleteTextures(1, &glyphTexture);
+        }
+    }
+
+    void setup() {
+        // one row of glyph cells, row 0 at the top
+        const int width = GLYPH_COUNT * GLYPH_WIDTH;
+        std::vector<unsigned char> texels(size_t(width) * GLYPH_HEIGHT, 0);
+        for (int glyph = 0; glyph < GLYPH_COUNT; glyph++)
+            for (int column = 0; column < 5; column++)
+                for (int row = 0; row < 7; row++)
+                    if (FONT[glyph][column] & (1 << row))
+                        texels[size_t(row) * width + glyph * GLYPH_WIDTH + column] = 255;
+
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+        glGenTextures(1, &glyphTexture);
+        glBindTexture(GL_TEXTURE_2D, glyphTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, GLYPH_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, texels.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, position));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *) offsetof(Vertex, texCoord));
+        glEnableVertexAttribArray(1);
+        glBindVertexArray(0);
+    }
+
+    // Draws `text` (lines separated by '\n') from the top-left corner, each font pixel `scale` pixels wide
+    void draw(const std::string &text, int viewportWidth, int viewportHeight, float scale = 2.0f) {
+        const float margin = 8.0f, cellWidth = GLYPH_WIDTH * scale, cellHeight = GLYPH_HEIGHT * scale;
+        const float glyphU = 1.0f / GLYPH_COUNT;
+        vertices.clear();
+        float x = margin, y = margin;
+        for (char c: text) {
+            if (c == '\n') {
+                x = margin;
+                y += cellHeight;
+                continue;
+            }
+            int glyph = std::toupper((unsigned char) c) - FIRST_GLYPH;
+            if (glyph < 0 || glyph >= GLYPH_COUNT)
+                glyph = '?' - FIRST_GLYPH;
+            float u0 = glyph * glyphU, u1 = u0 + glyphU;
+            Vertex topLeft{{x, y}, {u0, 0.0f}}, topRight{{x + cellWidth, y}, {u1, 0.0f}};
+            Vertex bottomLeft{{x, y + cellHeight}, {u0, 1.0f}}, bottomRight{{x + cellWidth, y + cellHeight}, {u1, 1.0f}};
+            vertices.insert(vertices.end(), {topLeft, bottomLeft, topRight, topRight, bottomLeft, bottomRight});
+            x += cellWidth;
+        }
+        if (vertices.empty())
+            return;
+
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(vertices.size() * sizeof(Vertex)), vertices.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        shader.use();
+        shader.setVec2("viewportSize", float(viewportWidth), float(viewportHeight));
+        shader.setInt("glyphs", 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, glyphTexture);
+        glBindVertexArray(vao);
+        glDrawArrays(GL_TRIANGLES, 0, GLsizei(vertices.size()));
+        glBindVertexArray(0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glDisable(GL_BLEND);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+private:
+    struct Vertex {
+        glm::vec2 position; // pixels from the top-left corner
+        glm::vec2 texCoord;
+    };
+
+    // Five columns per glyph, bit 0 is the top row
+    static constexpr unsigned char FONT[GLYPH_COUNT][5] = {
+            {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5F, 0x00, 0x00}, {0x00, 0x07, 0x00, 0x07, 0x00},
+            {0x14, 0x7F, 0x14, 0x7F, 0x14}, {0x24, 0x2A, 0x7F, 0x2A, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62},
+            {0x36, 0x49, 0x55, 0x22, 0x50}, {0x00, 0x05, 0x03, 0x00, 0x00}, {0x00, 0x1C, 0x22, 0x41, 0x00},
+            {0x00, 0x41, 0x22, 0x1C, 0x00}, {0x08, 0x2A, 0x1C, 0x2A, 0x08}, {0x08, 0x08, 0x3E, 0x08, 0x08},
+            {0x00, 0x50, 0x30, 0x00, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08}, {0x00, 0x60, 0x60, 0x00, 0x00},
+            {0x20, 0x10, 0x08, 0x04, 0x02}, {0x3E, 0x51, 0x49, 0x45, 0x3E}, {0x00, 0x42, 0x7F, 0x40, 0x00},
+            {0x42, 0x61, 0x51, 0x49, 0x46}, {0x21, 0x41, 0x45, 0x4B, 0x31}, {0x18, 0x14, 0x12, 0x7F, 0x10},
+            {0x27, 0x45, 0x45, 0x45, 0x39}, {0x3C, 0x4A, 0x49, 0x49, 0x30}, {0x01, 0x71, 0x09, 0x05, 0x03},
+            {0x36, 0x49, 0x49, 0x49, 0x36}, {0x06, 0x49, 0x49, 0x29, 0x1E}, {0x00, 0x36, 0x36, 0x00, 0x00},
+            {0x00, 0x56, 0x36, 0x00, 0x00}, {0x08, 0x14, 0x22, 0x41, 0x00}, {0x14, 0x14, 0x14, 0x14, 0x14},
+            {0x00, 0x41, 0x22, 0x14, 0x08}, {0x02, 0x01, 0x51, 0x09, 0x06}, {0x32, 0x49, 0x79, 0x41, 0x3E},
+            {0x7E, 0x11, 0x11, 0x11, 0x7E}, {0x7F, 0x49, 0x49, 0x49, 0x36}, {0x3E, 0x41, 0x41, 0x41, 0x22},
+            {0x7F, 0x41, 0x41, 0x22, 0x1C}, {0x7F, 0x49, 0x49, 0x49, 0x41}, {0x7F, 0x09, 0x09, 0x01, 0x01},
+            {0x3E, 0x41, 0x41, 0x51, 0x32}, {0x7F, 0x08, 0x08, 0x08, 0x7F}, {0x00, 0x41, 0x7F, 0x41, 0x00},
+            {0x20, 0x40, 0x41, 0x3F, 0x01}, {0x7F, 0x08, 0x14, 0x22, 0x41}, {0x7F, 0x40, 0x40, 0x40, 0x40},
+            {0x7F, 0x02, 0x04, 0x02, 0x7F}, {0x7F, 0x04, 0x08, 0x10, 0x7F}, {0x3E, 0x41, 0x41, 0x41, 0x3E},
+            {0x7F, 0x09, 0x09, 0x09, 0x06}, {0x3E, 0x41, 0x51, 0x21, 0x5E}, {0x7F, 0x09, 0x19, 0x29, 0x46},
+            {0x46, 0x49, 0x49, 0x49, 0x31}, {0x01, 0x01, 0x7F, 0x01, 0x01}, {0x3F, 0x40, 0x40, 0x40, 0x3F},
+            {0x1F, 0x20, 0x40, 0x20, 0x1F}, {0x7F, 0x20, 0x18, 0x20, 0x7F}, {0x63, 0x14, 0x08, 0x14, 0x63},
+            {0x03, 0x04, 0x78, 0x04, 0x03}, {0x61, 0x51, 0x49, 0x45, 0x43}, {0x00, 0x7F, 0x41, 0x41, 0x00},
+            {0x02, 0x04, 0x08, 0x10, 0x20}, {0x00, 0x41, 0x41, 0x7F, 0x00}, {0x04, 0x02, 0x01, 0x02, 0x04},
+            {0x40, 0x40, 0x40, 0x40, 0x40}
+    };
+
+    GLuint vao = 0, vbo = 0, glyphTexture = 0;
+    std::vector<Vertex> vertices;
+};
+
+#endif //RECONSTRUCTION_TEXTOVERLAY_H
@@ -0,0 +1,149 @@
+#ifndef RECONSTRUCTION_THREADPOOL_H
+#define RECONSTRUCTION_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "Trace.h"
+
+// Fixed set of worker threads for data-parallel loops. parallelFor() hands out [begin, end) ranges
+// of `grain` items from a shared atomic cursor, so threads that finish early keep pulling work, and
+// the calling thread joins in. Jobs are type-erased through a function pointer, so dispatching a
+// loop does not allocate.
+class ThreadPool {
+    struct Job {
+        void *context = nullptr;
+        void (*run)(void *, size_t, size_t) = nullptr;
+        size_t count = 0;
+        size_t grain = 1;
+        std::atomic<size_t> next{0};
+    };
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::mutex submit;
+    Job job;
+    unsigned generation = 0;
+    unsigned busy = 0;
+    bool stopping = false;
+
+    static bool &insideWorker() {
+        static thread_local bool inside = false;
+        return inside;
+    }
+
+    static void drain(Job &job) {
+        for (;;) {
+            size_t begin = job.next.fetch_add(job.grain, std::memory_order_relaxed);
+            if (begin >= job.count)
+                break;
+            size_t end = begin + job.grain < job.count ? begin + job.grain : job.count;
+            job.run(job.context, begin, end);
+        }
+    }
+
+    void workerLoop() {
+        insideWorker() = true;
+        Trace::nameThread("worker");
+        unsigned seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+            }
+            {
+                TRACE_ZONE("ThreadPool::job");
+                drain(job);
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--busy == 0)
+                    done.notify_one();
+            }
+        }
+    }
+
+public:
+    // `threads` counts the calling thread too; 0 picks the hardware concurrency
+    explicit ThreadPool(unsigned threads = 0) {
+        if (threads == 0)
+            threads = std::thread::hardware_concurrency();
+        if (threads == 0)
+            threads = 1;
+        for (unsigned k = 1; k < threads; k++)
+            workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &worker: workers)
+            worker.join();
+    }
+
+    unsigned size() const {
+        return unsigned(workers.size()) + 1;
+    }
+
+    // Calls fn(begin, end) over [0, count) in chunks of `grain` items and returns once all of them ran.
+    // Nested calls from inside a worker run inline.
+    template<typename Function>
+    void parallelFor(size_t count, size_t grain, Function &&fn) {
+        if (count == 0)
+            return;
+        if (grain == 0)
+            grain = 1;
+        if (workers.empty() || count <= grain || insideWorker()) {
+            for (size_t begin = 0; begin < count; begin += grain)
+                fn(begin, begin + grain < count ? begin + grain : count);
+            return;
+        }
+
+        std::lock_guard<std::mutex> serialize(submit);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job.context = (void *) &fn;
+            job.run = [](void *context, size_t begin, size_t end) {
+                (*static_cast<typename std::remove_reference<Function>::type *>(context))(begin, end);
+            };
+            job.count = count;
+            job.grain = grain;
+            job.next.store(0, std::memory_order_relaxed);
+            busy = unsigned(workers.size());
+            generation++;
+        }
+        wake.notify_all();
+
+        TRACE_ZONE("ThreadPool::parallelFor");
+        insideWorker() = true;
+        drain(job);
+        insideWorker() = false;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return busy == 0; });
+    }
+
+    // Process-wide pool used by the loaders and mesh builders; `threads` only counts on the first call
+    static ThreadPool &shared(unsigned threads = 0) {
+        static ThreadPool pool(threads);
+        return pool;
+    }
+};
+
+#endif //RECONSTRUCTION_THREADPOOL_H
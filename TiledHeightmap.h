@@ -0,0 +1,255 @@
+#ifndef RECONSTRUCTION_TILEDHEIGHTMAP_H
+#define RECONSTRUCTION_TILEDHEIGHTMAP_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Grid2D.h"
+#include "HeightmapIO.h"
+#include "ThreadPool.h"
+
+// Tiled heightmap container (.tiles) for maps too large to hold in memory. Little-endian, laid out as
+//   TileSetHeader | TileEntry[tileRows * tileCols] | tile payloads
+// Tile (r, c) covers the quads of rows [r * tileSize, (r + 1) * tileSize) and the same columns, i.e. the
+// (tileSize + 1)^2 samples at its corners, plus a one-sample apron on every side for the normals: a payload is
+// a tileSide()^2 grid of heights (in the header's format) followed, when the set has colors, by as many RGB
+// bytes, each on a HEIGHTMAP_ALIGNMENT boundary. Samples past the map edge repeat the edge. The directory
+// holds every tile's offset and normalized height range, so tiles can be culled before they are read.
+const char TILESET_MAGIC[4] = {'R', 'T', 'I', 'L'};
+const uint32_t TILESET_VERSION = 1;
+const int DEFAULT_TILE_SIZE = 256;
+
+struct TileSetHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t tileSize;      // quads per tile side
+    uint32_t tileRows;
+    uint32_t tileCols;
+    float minHeight;
+    float maxHeight;
+    uint32_t format;        // HeightFormat
+    uint32_t flags;         // HEIGHTMAP_HAS_RGB
+    uint32_t reserved;
+    uint64_t directoryOffset;
+};
+
+static_assert(sizeof(TileSetHeader) == 56, "TileSetHeader must stay binary compatible");
+
+struct TileEntry {
+    uint64_t offset;
+    float heightMin, heightMax; // normalized range of the tile's own samples
+};
+
+static_assert(sizeof(TileEntry) == 16, "TileEntry must stay binary compatible");
+
+// Samples per side of a stored tile
+inline int tileSide(int tileSize) {
+    return tileSize + 3;
+}
+
+// Payload bytes of one tile
+inline uint64_t tilePayloadSize(int tileSize, uint32_t format, bool withRGB) {
+    uint64_t samples = uint64_t(tileSide(tileSize)) * uint64_t(tileSide(tileSize));
+    uint64_t heights = alignHeightmapOffset(samples * heightFormatSize(format));
+    return withRGB ? heights + alignHeightmapOffset(samples * sizeof(glm::u8vec3)) : heights;
+}
+
+inline float unitHeight(float h) {
+    return h;
+}
+
+inline float unitHeight(uint16_t h) {
+    return float(h) * (1.0f / 65535.0f);
+}
+
+// A mapped .tiles file; tiles are read through the mapping, so any thread may read them at once
+class TileSetFile {
+    MappedFile file;
+    TileSetHeader head{};
+    const TileEntry *entries = nullptr;
+public:
+    bool open(const std::string &path) {
+        entries = nullptr;
+        if (!file.open(path, false)) {
+            std::cerr << "Error: Could not map the file " << path << std::endl;
+            return false;
+        }
+        if (file.size() < sizeof(TileSetHeader)) {
+            std::cerr << "Error: " << path << " is too small to be a tile set" << std::endl;
+            file.close();
+            return false;
+        }
+        std::memcpy(&head, file.data(), sizeof(TileSetHeader));
+        if (std::memcmp(head.magic, TILESET_MAGIC, sizeof(TILESET_MAGIC)) != 0 || head.version != TILESET_VERSION ||
+            head.format > HEIGHT_UNORM16 || head.tileSize == 0) {
+            std::cerr << "Error: " << path << " is not a version " << TILESET_VERSION << " tile set" << std::endl;
+            file.close();
+            return false;
+        }
+        uint64_t tiles = uint64_t(head.tileRows) * head.tileCols;
+        bool fits = head.directoryOffset % alignof(TileEntry) == 0 &&
+                    head.directoryOffset + tiles * sizeof(TileEntry) <= file.size();
+        if (fits) {
+            entries = reinterpret_cast<const TileEntry *>(file.data() + head.directoryOffset);
+            uint64_t payload = tilePayloadSize(int(head.tileSize), head.format, hasRGB());
+            for (uint64_t t = 0; t < tiles && fits; t++)
+                fits = entries[t].offset % HEIGHTMAP_ALIGNMENT == 0 && entries[t].offset + payload <= file.size();
+        }
+        if (!fits) {
+            std::cerr << "Error: " << path << " is truncated" << std::endl;
+            file.close();
+            entries = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    bool isOpen() const {
+        return entries != nullptr;
+    }
+
+    const TileSetHeader &header() const {
+        return head;
+    }
+
+    bool hasRGB() const {
+        return (head.flags & HEIGHTMAP_HAS_RGB) != 0;
+    }
+
+    int tileCount() const {
+        return int(head.tileRows * head.tileCols);
+    }
+
+    const TileEntry &entry(int tile) const {
+        return entries[tile];
+    }
+
+    // Normalized heights of a tile, apron included, expanded to floats
+    void readHeights(int tile, Grid2D<float> &heights) const {
+        const int side = tileSide(int(head.tileSize));
+        const unsigned char *payload = file.data() + entries[tile].offset;
+        for (int i = 0; i < side; i++) {
+            float *out = heights.row(i);
+            if (head.format == HEIGHT_FLOAT32) {
+                std::memcpy(out, payload + size_t(i) * side * sizeof(float), size_t(side) * sizeof(float));
+            } else {
+                const uint16_t *in = reinterpret_cast<const uint16_t *>(payload) + size_t(i) * side;
+                for (int j = 0; j < side; j++)
+                    out[j] = unitHeight(in[j]);
+            }
+        }
+    }
+
+    // Colors of a tile, apron included, or white when the set has none
+    void readRGB(int tile, Grid2D<glm::u8vec3> &colors) const {
+        const int side = tileSide(int(head.tileSize));
+        const size_t samples = size_t(side) * side;
+        const unsigned char *rgb = file.data() + entries[tile].offset +
+                                   alignHeightmapOffset(samples * heightFormatSize(head.format));
+        for (int i = 0; i < side; i++) {
+            glm::u8vec3 *out = colors.row(i);
+            if (hasRGB())
+                std::memcpy(out, rgb + size_t(i) * side * sizeof(glm::u8vec3), size_t(side) * sizeof(glm::u8vec3));
+            else
+                std::fill(out, out + side, glm::u8vec3(255));
+        }
+    }
+
+    // Lets the page cache drop a tile that has been read
+    void release(int tile) const {
+        file.drop(size_t(entries[tile].offset), size_t(tilePayloadSize(int(head.tileSize), head.format, hasRGB())));
+    }
+
+    // Cuts a heightmap (float or unorm16 heights, e.g. straight from a mapped .hmap) into tiles; a row of tiles
+    // is gathered in parallel, then written
+    template<typename Height>
+    static bool write(const std::string &path, float minHeight, float maxHeight, const Grid2D<const Height> &heights,
+                      const Grid2D<const glm::u8vec3> &rgb, int tileSize = DEFAULT_TILE_SIZE,
+                      HeightFormat format = HEIGHT_FLOAT32) {
+        std::ofstream out(path, std::ios::binary);
+        if (!out.is_open()) {
+            std::cerr << "Error: Could not open the file " << path << std::endl;
+            return false;
+        }
+        const int rows = heights.rows(), cols = heights.cols(), side = tileSide(tileSize);
+        const bool withRGB = !rgb.empty() && rgb.rows() == rows && rgb.cols() == cols;
+
+        TileSetHeader header{};
+        std::memcpy(header.magic, TILESET_MAGIC, sizeof(TILESET_MAGIC));
+        header.version = TILESET_VERSION;
+        header.rows = uint32_t(rows);
+        header.cols = uint32_t(cols);
+        header.tileSize = uint32_t(tileSize);
+        header.tileRows = uint32_t((rows - 2) / tileSize + 1);
+        header.tileCols = uint32_t((cols - 2) / tileSize + 1);
+        header.minHeight = minHeight;
+        header.maxHeight = maxHeight;
+        header.format = format;
+        header.flags = withRGB ? HEIGHTMAP_HAS_RGB : 0;
+        header.directoryOffset = sizeof(TileSetHeader);
+
+        std::vector<TileEntry> directory(size_t(header.tileRows) * header.tileCols);
+        const uint64_t payloadSize = tilePayloadSize(tileSize, format, withRGB);
+        const uint64_t heightBytes = uint64_t(side) * side * heightFormatSize(format);
+        const uint64_t rgbOffset = alignHeightmapOffset(heightBytes);
+        uint64_t offset = alignHeightmapOffset(header.directoryOffset + directory.size() * sizeof(TileEntry));
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(directory.data()), std::streamsize(directory.size() * sizeof(TileEntry)));
+        out.seekp(std::streamoff(offset));
+
+        std::vector<unsigned char> payloads(size_t(payloadSize) * header.tileCols);
+        for (int tr = 0; tr < int(header.tileRows); tr++) {
+            std::fill(payloads.begin(), payloads.end(), 0);
+            ThreadPool::shared().parallelFor(header.tileCols, 1, [&](size_t first, size_t last) {
+                for (size_t tc = first; tc < last; tc++) {
+                    unsigned char *payload = payloads.data() + tc * payloadSize;
+                    const int row0 = tr * tileSize - 1, col0 = int(tc) * tileSize - 1;
+                    TileEntry &entry = directory[size_t(tr) * header.tileCols + tc];
+                    entry.heightMin = 1.0f;
+                    entry.heightMax = 0.0f;
+                    for (int i = 0; i < side; i++) {
+                        const int gi = std::clamp(row0 + i, 0, rows - 1);
+                        const Height *in = heights.row(gi);
+                        const glm::u8vec3 *colors = withRGB ? rgb.row(gi) : nullptr;
+                        for (int j = 0; j < side; j++) {
+                            const int gj = std::clamp(col0 + j, 0, cols - 1);
+                            const float h = unitHeight(in[gj]);
+                            // the range covers the tile's own samples, not the apron
+                            if (i >= 1 && i <= tileSize + 1 && j >= 1 && j <= tileSize + 1) {
+                                entry.heightMin = std::min(entry.heightMin, h);
+                                entry.heightMax = std::max(entry.heightMax, h);
+                            }
+                            const size_t k = size_t(i) * side + j;
+                            if (format == HEIGHT_UNORM16) {
+                                uint16_t packed = uint16_t(std::lround(std::clamp(h, 0.0f, 1.0f) * 65535.0f));
+                                std::memcpy(payload + k * sizeof(uint16_t), &packed, sizeof(packed));
+                            } else {
+                                std::memcpy(payload + k * sizeof(float), &h, sizeof(h));
+                            }
+                            if (withRGB)
+                                std::memcpy(payload + rgbOffset + k * sizeof(glm::u8vec3), &colors[gj],
+                                            sizeof(glm::u8vec3));
+                        }
+                    }
+                    entry.offset = offset + tc * payloadSize;
+                }
+            });
+            out.write(reinterpret_cast<const char *>(payloads.data()), std::streamsize(payloads.size()));
+            offset += payloads.size();
+        }
+
+        out.seekp(std::streamoff(header.directoryOffset));
+        out.write(reinterpret_cast<const char *>(directory.data()), std::streamsize(directory.size() * sizeof(TileEntry)));
+        return bool(out);
+    }
+};
+
+#endif //RECONSTRUCTION_TILEDHEIGHTMAP_H
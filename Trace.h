@@ -0,0 +1,170 @@
+#ifndef RECONSTRUCTION_TRACE_H
+#define RECONSTRUCTION_TRACE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Scoped CPU zones written as Chrome trace events (load the file in chrome://tracing or Perfetto).
+// Every thread records into its own ring buffer of the last CAPACITY zones, so recording takes no lock;
+// the buffers are only registered (once per thread, under a mutex) and collected by write(), which should
+// run while the other threads are idle. Zones cost one relaxed atomic load while tracing is disabled.
+//
+//     TRACE_ZONE("Map::setup");              // until the end of the enclosing scope
+//     Trace::Zone zone("Shader", vertexPath); // with a detail shown in the event's arguments
+class Trace {
+public:
+    static const size_t CAPACITY = 1 << 14;
+    static const size_t DETAIL_LENGTH = 48;
+
+    struct Event {
+        const char *name;   // must outlive the trace, e.g. a string literal
+        char detail[DETAIL_LENGTH];
+        uint64_t start;     // nanoseconds since the trace was enabled
+        uint64_t duration;
+    };
+
+    class Zone {
+    public:
+        explicit Zone(const char *name, const char *detail = nullptr) : name(name), detail(detail) {
+            if (enabled())
+                start = now();
+        }
+
+        Zone(const Zone &) = delete;
+
+        Zone &operator=(const Zone &) = delete;
+
+        ~Zone() {
+            if (start != NOT_STARTED && enabled())
+                record(name, detail, start, now() - start);
+        }
+
+    private:
+        static const uint64_t NOT_STARTED = ~uint64_t(0);
+
+        const char *name;
+        const char *detail;
+        uint64_t start = NOT_STARTED;
+    };
+
+    static bool enabled() {
+        return flag().load(std::memory_order_relaxed);
+    }
+
+    static void enable() {
+        epoch();
+        flag().store(true, std::memory_order_relaxed);
+    }
+
+    // Name shown for the calling thread's track
+    static void nameThread(const char *name) {
+        std::snprintf(threadBuffer().name, sizeof(ThreadBuffer::name), "%s", name);
+    }
+
+    // Writes the zones of every thread as a Chrome trace-event JSON file
+    static bool write(const std::string &path) {
+        std::FILE *out = std::fopen(path.c_str(), "w");
+        if (out == nullptr)
+            return false;
+        std::fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+        bool first = true;
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        for (size_t tid = 0; tid < registry().buffers.size(); tid++) {
+            const ThreadBuffer &buffer = *registry().buffers[tid];
+            std::fprintf(out, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %zu, "
+                              "\"args\": {\"name\": \"%s\"}}", first ? "" : ",\n", tid, buffer.name);
+            first = false;
+            size_t head = buffer.head.load(std::memory_order_acquire);
+            for (size_t k = head > CAPACITY ? head - CAPACITY : 0; k < head; k++) {
+                const Event &event = buffer.events[k % CAPACITY];
+                std::fprintf(out, ",\n{\"name\": \"%s\", \"cat\": \"reconstruction\", \"ph\": \"X\", \"pid\": 1, "
+                                  "\"tid\": %zu, \"ts\": %.3f, \"dur\": %.3f", event.name, tid,
+                             double(event.start) * 1e-3, double(event.duration) * 1e-3);
+                if (event.detail[0] != '\0')
+                    std::fprintf(out, ", \"args\": {\"detail\": \"%s\"}", escaped(event.detail).c_str());
+                std::fprintf(out, "}");
+            }
+        }
+        std::fprintf(out, "\n]}\n");
+        return std::fclose(out) == 0;
+    }
+
+private:
+    struct ThreadBuffer {
+        char name[32] = "thread";
+        std::unique_ptr<Event[]> events; // allocated on the first zone
+        std::atomic<size_t> head{0};     // zones ever recorded; only the owning thread writes it
+    };
+
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers; // never freed, so exited threads keep their zones
+    };
+
+    static std::atomic<bool> &flag() {
+        static std::atomic<bool> on{false};
+        return on;
+    }
+
+    static Registry &registry() {
+        static Registry instance;
+        return instance;
+    }
+
+    static std::chrono::steady_clock::time_point epoch() {
+        static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        return start;
+    }
+
+    static uint64_t now() {
+        return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - epoch()).count());
+    }
+
+    static ThreadBuffer &threadBuffer() {
+        static thread_local ThreadBuffer *buffer = nullptr;
+        if (buffer == nullptr) {
+            std::lock_guard<std::mutex> lock(registry().mutex);
+            registry().buffers.emplace_back(new ThreadBuffer());
+            buffer = registry().buffers.back().get();
+        }
+        return *buffer;
+    }
+
+    static void record(const char *name, const char *detail, uint64_t start, uint64_t duration) {
+        ThreadBuffer &buffer = threadBuffer();
+        if (!buffer.events)
+            buffer.events.reset(new Event[CAPACITY]);
+        size_t head = buffer.head.load(std::memory_order_relaxed);
+        Event &event = buffer.events[head % CAPACITY];
+        event.name = name;
+        std::snprintf(event.detail, DETAIL_LENGTH, "%s", detail != nullptr ? detail : "");
+        event.start = start;
+        event.duration = duration;
+        buffer.head.store(head + 1, std::memory_order_release);
+    }
+
+    static std::string escaped(const char *text) {
+        std::string result;
+        for (; *text != '\0'; text++) {
+            if (*text == '"' || *text == '\\')
+                result += '\\';
+            result += *text;
+        }
+        return result;
+    }
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_ZONE(name) Trace::Zone TRACE_CONCAT(traceZone, __LINE__)(name)
+
+#endif //RECONSTRUCTION_TRACE_H
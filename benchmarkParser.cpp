@@ -0,0 +1,94 @@
+#include "HeightmapIO.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Compares the parallel text grid parser against the getline + istringstream loop Map used to run.
+// usage: benchmarkParser <file> <rows> <cols> [components]
+//        benchmarkParser --synthetic <rows> <cols> [components]   (writes benchmark_synthetic.txt first)
+
+static std::vector<float> legacyParse(const std::string &path) {
+    std::ifstream file(path);
+    std::vector<float> values;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream iss(line);
+        double value;
+        while (iss >> value)
+            values.push_back(float(value));
+    }
+    return values;
+}
+
+static void writeSynthetic(const std::string &path, int rows, int cols, int components) {
+    std::FILE *file = std::fopen(path.c_str(), "w");
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols * components; j++)
+            std::fprintf(file, j == 0 ? "%.6g" : " %.6g", dist(rng));
+        std::fputc('\n', file);
+    }
+    std::fclose(file);
+}
+
+template<typename Function>
+static double timeSeconds(Function &&fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    if (argc < 4) {
+        std::cout << "Usage: benchmarkParser <file> <rows> <cols> [components]" << std::endl;
+        std::cout << "       benchmarkParser --synthetic <rows> <cols> [components]" << std::endl;
+        return 1;
+    }
+    std::string path = argv[1];
+    int rows = std::stoi(argv[2]);
+    int cols = std::stoi(argv[3]);
+    int components = argc > 4 ? std::stoi(argv[4]) : 1;
+    if (path == "--synthetic") {
+        path = "benchmark_synthetic.txt";
+        std::cout << "writing " << rows << "x" << cols << "x" << components << " grid to " << path << std::endl;
+        writeSynthetic(path, rows, cols, components);
+    }
+
+    std::ifstream probe(path, std::ios::binary | std::ios::ate);
+    if (!probe.is_open()) {
+        std::cerr << "Error: Could not open the file " << path << std::endl;
+        return 1;
+    }
+    double megabytes = double(probe.tellg()) / (1024.0 * 1024.0);
+
+    std::vector<float> legacy;
+    double legacySeconds = timeSeconds([&] { legacy = legacyParse(path); });
+
+    std::vector<float> parallel(size_t(rows) * cols * components, 0.0f);
+    float *out = parallel.data();
+    const size_t rowValues = size_t(cols) * components;
+    TextGridResult result;
+    double parallelSeconds = timeSeconds([&] {
+        result = parseTextGrid(path, rows, cols, components, [out, rowValues](size_t row, size_t index, float value) {
+            out[row * rowValues + index] = value;
+        });
+    });
+
+    size_t mismatches = legacy.size() == result.values ? 0 : 1;
+    for (size_t k = 0; k < legacy.size() && k < parallel.size(); k++)
+        mismatches += legacy[k] != parallel[k];
+
+    std::printf("file:      %s (%.1f MB)\n", path.c_str(), megabytes);
+    std::printf("threads:   %u\n", ThreadPool::shared().size());
+    std::printf("legacy:    %.3f s (%.1f MB/s)\n", legacySeconds, megabytes / legacySeconds);
+    std::printf("parallel:  %.3f s (%.1f MB/s)\n", parallelSeconds, megabytes / parallelSeconds);
+    std::printf("speedup:   %.1fx\n", legacySeconds / parallelSeconds);
+    std::printf("values:    %zu legacy, %zu parallel, %zu mismatches\n", legacy.size(), result.values, mismatches);
+    return mismatches == 0 ? 0 : 2;
+}
@@ -0,0 +1,291 @@
+#include <glad.h>
+
+#include <glm/glm.hpp>
+
+#include "HeadlessContext.h"
+#include "OffscreenTarget.h"
+#include "Scene.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Replays a camera path over a map for a fixed number of frames in an offscreen context and reports load
+// times, frame time percentiles and what was drawn as JSON. Frames advance a fixed timestep instead of the
+// wall clock, so two runs draw exactly the same images.
+// usage: benchmarkRender <meta.data> [--frames <n>] [--warmup <n>] [--path <camera path>] [--size <width>x<height>]
+//                        [--threads <count>] [--gpu-displacement] [--lod] [--simplify <max error>] [--occlusion]
+//                        [--output <file>] [--trace <trace.json>]
+// The map is read from the data/ directory next to the metadata file, the layout main.cpp expects. A camera
+// path has one "x y z yaw pitch" pose per frame (main --record writes one; --headless pose files work too)
+// and is looped if shorter than the run; without one the camera circles the map.
+
+struct Pose {
+    glm::vec3 position;
+    float yaw, pitch;
+};
+
+struct Summary {
+    double mean = 0, p50 = 0, p90 = 0, p95 = 0, p99 = 0, max = 0;
+};
+
+static const double TIMESTEP = 1.0 / 60.0;
+
+static bool readPath(const std::string &path, std::vector<Pose> &poses) {
+    std::ifstream file(path);
+    if (!file.is_open())
+        return false;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream iss(line);
+        Pose pose;
+        if (iss >> pose.position.x >> pose.position.y >> pose.position.z >> pose.yaw >> pose.pitch)
+            poses.push_back(pose);
+    }
+    return !poses.empty();
+}
+
+// Flies a circle around the middle of the map, looking along the flight direction and slightly down; one lap
+// takes `period` seconds
+static Pose orbitPose(int rows, int cols, float maxHeight, double time, double period) {
+    const double pi = 3.14159265358979323846;
+    double angle = 2.0 * pi * time / period;
+    float radius = 0.25f * float(std::min(rows, cols));
+    Pose pose;
+    pose.position = glm::vec3(float(rows) / 2.0f + radius * float(std::cos(angle)), maxHeight + 20.0f,
+                              float(cols) / 2.0f + radius * float(std::sin(angle)));
+    pose.yaw = float(angle * 180.0 / pi) + 90.0f;
+    pose.pitch = -20.0f;
+    return pose;
+}
+
+static Summary summarize(std::vector<double> values) {
+    Summary summary;
+    if (values.empty())
+        return summary;
+    std::sort(values.begin(), values.end());
+    auto percentile = [&values](double p) {
+        size_t rank = size_t(std::ceil(p / 100.0 * double(values.size())));
+        return values[std::min(values.size() - 1, rank == 0 ? 0 : rank - 1)];
+    };
+    for (double value: values)
+        summary.mean += value;
+    summary.mean /= double(values.size());
+    summary.p50 = percentile(50);
+    summary.p90 = percentile(90);
+    summary.p95 = percentile(95);
+    summary.p99 = percentile(99);
+    summary.max = values.back();
+    return summary;
+}
+
+static std::string jsonString(const std::string &text) {
+    std::string quoted = "\"";
+    for (char c: text) {
+        if (c == '"' || c == '\\')
+            quoted += '\\';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+static void printSummary(std::FILE *out, const char *name, const Summary &summary) {
+    std::fprintf(out, "  \"%s\": {\"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p95\": %.4f, \"p99\": %.4f, "
+                      "\"max\": %.4f},\n", name, summary.mean, summary.p50, summary.p90, summary.p95, summary.p99,
+                 summary.max);
+}
+
+template<typename Function>
+static double timeSeconds(Function &&fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 || argv[1][0] == '-') {
+        std::cout << "Usage: benchmarkRender <meta.data> [--frames <n>] [--warmup <n>] [--path <camera path>]"
+                     " [--size <width>x<height>] [--threads <count>] [--gpu-displacement] [--lod]"
+                     " [--simplify <max error>] [--occlusion] [--output <file>] [--trace <trace.json>]" << std::endl;
+        return 1;
+    }
+    std::string metadataPath = argv[1];
+    int frames = 600, warmup = 30;
+    int width = 800, height = 600;
+    unsigned threads = 0;
+    bool gpuDisplacement = false, lod = false, simplify = false, occlusion = false;
+    float maxError = 0.5f;
+    std::string cameraPath, outputPath, tracePath;
+    for (int k = 2; k < argc; k++) {
+        std::string arg = argv[k];
+        if (arg == "--frames" && k + 1 < argc) {
+            frames = std::stoi(argv[++k]);
+        } else if (arg == "--warmup" && k + 1 < argc) {
+            warmup = std::stoi(argv[++k]);
+        } else if (arg == "--path" && k + 1 < argc) {
+            cameraPath = argv[++k];
+        } else if (arg == "--size" && k + 1 < argc) {
+            if (std::sscanf(argv[++k], "%dx%d", &width, &height) != 2)
+                width = height = 0;
+        } else if (arg == "--threads" && k + 1 < argc) {
+            threads = unsigned(std::stoi(argv[++k]));
+        } else if (arg == "--gpu-displacement") {
+            gpuDisplacement = true;
+        } else if (arg == "--lod") {
+            lod = true;
+        } else if (arg == "--simplify" && k + 1 < argc) {
+            simplify = true;
+            maxError = std::stof(argv[++k]);
+        } else if (arg == "--occlusion") {
+            occlusion = true;
+        } else if (arg == "--trace" && k + 1 < argc) {
+            tracePath = argv[++k];
+        } else if (arg == "--output" && k + 1 < argc) {
+            outputPath = argv[++k];
+        } else {
+            std::cerr << "Error: Unknown argument " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (frames <= 0 || warmup < 0 || width <= 0 || height <= 0) {
+        std::cerr << "Error: --frames, --warmup and --size must be positive" << std::endl;
+        return 1;
+    }
+    if (!tracePath.empty())
+        Trace::enable();
+    Trace::nameThread("main");
+    ThreadPool::shared(threads);
+
+    // same metadata format as main.cpp: the map name, then "rows cols"
+    std::ifstream metadata(metadataPath);
+    std::string name, line;
+    int rows = 0, cols = 0;
+    if (!std::getline(metadata, name) || !std::getline(metadata, line) || !(std::istringstream(line) >> rows >> cols)) {
+        std::cerr << "Error: Unable to read " << metadataPath << std::endl;
+        return 1;
+    }
+    size_t slash = metadataPath.find_last_of('/');
+    std::string dataDir = (slash == std::string::npos ? std::string(".") : metadataPath.substr(0, slash)) + "/data/";
+    std::string binaryPath = dataDir + "binary/" + name + ".hmap";
+
+    std::vector<Pose> path;
+    if (!cameraPath.empty() && !readPath(cameraPath, path)) {
+        std::cerr << "Error: No poses in " << cameraPath << std::endl;
+        return 1;
+    }
+
+    // same defaults as main.cpp
+    const float minHeight = -10.0f, maxHeight = 0.0f;
+    Map map(rows, cols, minHeight, maxHeight, dataDir + "elevation/" + name + ".e", dataDir + "rgb/" + name + ".rgb");
+    if (std::ifstream(binaryPath).good())
+        map.use_binary(binaryPath);
+    map.change_proximity(1.0);
+    map.use_gpu_displacement(gpuDisplacement);
+    map.use_lod(lod);
+    map.use_simplification(simplify);
+    map.use_occlusion_culling(occlusion);
+    map.set_max_error(maxError);
+    glm::vec3 lightPos(rows / 2, maxHeight + 5, cols / 2);
+    Cube cube(lightPos);
+
+    HeadlessContext context;
+    bool created = false;
+    double contextSeconds = timeSeconds([&] {
+        created = context.create() && gladLoadGLLoader((GLADloadproc) HeadlessContext::procAddress);
+    });
+    if (!created) {
+        std::cerr << "Error: Failed to create an offscreen OpenGL context" << std::endl;
+        return 1;
+    }
+    OffscreenTarget target;
+    if (!target.setup(width, height))
+        return 1;
+    target.bind();
+    glEnable(GL_DEPTH_TEST);
+    auto shaderStart = std::chrono::steady_clock::now();
+    Scene scene;
+    double shaderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - shaderStart).count();
+    double mapSeconds = timeSeconds([&] {
+        map.setup();
+        glFinish();
+    });
+    cube.setup();
+
+    // cpu: issuing the frame's commands; frame: until the GPU has finished them
+    std::vector<double> cpuMs, frameMs;
+    std::vector<double> draws, drawCalls, triangles, visibleChunks, frustumCulled, occlusionCulled;
+    Camera camera;
+    for (int frame = -warmup; frame < frames; frame++) {
+        int step = frame + warmup;
+        Pose pose = path.empty() ? orbitPose(rows, cols, maxHeight, step * TIMESTEP, frames * TIMESTEP)
+                                 : path[size_t(step) % path.size()];
+        camera = Camera(pose.position, glm::vec3(0.0f, 1.0f, 0.0f), pose.yaw, pose.pitch);
+
+        TRACE_ZONE("frame");
+        auto start = std::chrono::steady_clock::now();
+        scene.draw(map, cube, camera, lightPos, 1.0f, width, height);
+        auto issued = std::chrono::steady_clock::now();
+        glFinish();
+        auto finished = std::chrono::steady_clock::now();
+        if (frame < 0)
+            continue;
+        cpuMs.push_back(std::chrono::duration<double, std::milli>(issued - start).count());
+        frameMs.push_back(std::chrono::duration<double, std::milli>(finished - start).count());
+        const Map::FrameStats &stats = map.frame_stats();
+        draws.push_back(double(stats.draws));
+        drawCalls.push_back(double(stats.drawCalls));
+        triangles.push_back(double(stats.triangles));
+        visibleChunks.push_back(double(stats.visibleChunks));
+        frustumCulled.push_back(double(stats.frustumCulled));
+        occlusionCulled.push_back(double(stats.occlusionCulled));
+    }
+
+    std::FILE *out = outputPath.empty() ? stdout : std::fopen(outputPath.c_str(), "w");
+    if (out == nullptr) {
+        std::cerr << "Error: Unable to write " << outputPath << std::endl;
+        return 1;
+    }
+    const char *mode = map.uses_gpu_displacement() ? "gpu-displacement" : map.uses_lod() ? "lod"
+                                                                         : map.uses_simplification() ? "simplify"
+                                                                                                     : "full";
+    std::fprintf(out, "{\n");
+    std::fprintf(out, "  \"map\": %s,\n", jsonString(metadataPath).c_str());
+    std::fprintf(out, "  \"rows\": %d,\n  \"cols\": %d,\n", rows, cols);
+    std::fprintf(out, "  \"mode\": \"%s\",\n", mode);
+    std::fprintf(out, "  \"renderer\": %s,\n", jsonString((const char *) glGetString(GL_RENDERER)).c_str());
+    std::fprintf(out, "  \"occlusionCulling\": %s,\n", map.uses_occlusion_culling() ? "true" : "false");
+    std::fprintf(out, "  \"threads\": %u,\n", ThreadPool::shared().size());
+    std::fprintf(out, "  \"width\": %d,\n  \"height\": %d,\n", width, height);
+    std::fprintf(out, "  \"frames\": %d,\n  \"warmupFrames\": %d,\n  \"timestep\": %.6f,\n", frames, warmup, TIMESTEP);
+    std::fprintf(out, "  \"cameraPath\": %s,\n", path.empty() ? "\"orbit\"" : jsonString(cameraPath).c_str());
+    std::fprintf(out, "  \"setupSeconds\": {\"context\": %.4f, \"shaders\": %.4f, \"map\": %.4f},\n", contextSeconds,
+                 shaderSeconds, mapSeconds);
+    printSummary(out, "cpuFrameMs", summarize(cpuMs));
+    printSummary(out, "frameMs", summarize(frameMs));
+    printSummary(out, "draws", summarize(draws));
+    printSummary(out, "drawCalls", summarize(drawCalls));
+    printSummary(out, "visibleChunks", summarize(visibleChunks));
+    printSummary(out, "frustumCulled", summarize(frustumCulled));
+    printSummary(out, "occlusionCulled", summarize(occlusionCulled));
+    Summary triangleSummary = summarize(triangles);
+    std::fprintf(out, "  \"triangles\": {\"mean\": %.1f, \"p50\": %.0f, \"max\": %.0f}\n", triangleSummary.mean,
+                 triangleSummary.p50, triangleSummary.max);
+    std::fprintf(out, "}\n");
+    if (out != stdout)
+        std::fclose(out);
+    if (!tracePath.empty() && !Trace::write(tracePath)) {
+        std::cerr << "Error: Unable to write " << tracePath << std::endl;
+        return 1;
+    }
+    return 0;
+}
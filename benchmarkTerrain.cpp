@@ -0,0 +1,85 @@
+#include "TerrainGenerator.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Throughput of the terrain generator: one thread on the scalar loop, one thread on the vector path, then the
+// full tiled generator (heights and biome classification) on the shared pool.
+// usage: benchmarkTerrain [rows] [cols] [--threads n] [--octaves n]
+
+template<typename Function>
+static double timeSeconds(Function &&fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    int rows = 4096, cols = 4096;
+    unsigned threads = 0;
+    TerrainNoise noise;
+    noise.scale = 256.0f;
+    int positional = 0;
+    for (int k = 1; k < argc; k++) {
+        std::string arg = argv[k];
+        if (arg == "--threads" && k + 1 < argc) {
+            threads = unsigned(std::stoi(argv[++k]));
+        } else if (arg == "--octaves" && k + 1 < argc) {
+            noise.octaves = std::stoi(argv[++k]);
+        } else if (positional < 2 && !arg.empty() && arg[0] != '-') {
+            (positional++ == 0 ? rows : cols) = std::stoi(arg);
+        } else {
+            std::cout << "Usage: benchmarkTerrain [rows] [cols] [--threads n] [--octaves n]" << std::endl;
+            return 1;
+        }
+    }
+    ThreadPool::shared(threads);
+
+    // single-threaded noise over a band of rows, scalar then vectorized
+    const int bandRows = std::min(rows, 256);
+    std::vector<float> scalar(size_t(bandRows) * cols, 0.0f), vector(size_t(bandRows) * cols, 0.0f);
+    auto band = [&](std::vector<float> &out, bool vectorized) {
+        for (int o = 0; o < noise.octaves; o++) {
+            OpenSimplex2 octave(noise.seed + uint32_t(o));
+            float frequency = float(1 << o) / noise.scale, amplitude = 1.0f / float(1 << o);
+            for (int i = 0; i < bandRows; i++) {
+                float *line = &out[size_t(i) * cols];
+                if (vectorized)
+                    octave.accumulateLine(float(i) * frequency, 0.0f, frequency, cols, amplitude, line);
+                else
+                    octave.accumulateLineScalar(float(i) * frequency, 0.0f, frequency, 0, cols, amplitude, line);
+            }
+        }
+    };
+    double scalarSeconds = timeSeconds([&] { band(scalar, false); });
+    double vectorSeconds = timeSeconds([&] { band(vector, true); });
+    float maxDifference = 0.0f;
+    for (size_t k = 0; k < scalar.size(); k++)
+        maxDifference = std::max(maxDifference, std::fabs(scalar[k] - vector[k]));
+
+    Grid2D<float> heights;
+    Grid2D<glm::u8vec3> colors;
+    double heightSeconds = timeSeconds([&] { generateHeights(noise, rows, cols, heights); });
+    double classifySeconds = timeSeconds([&] { classifyTerrain(heights, colors); });
+
+    const double bandSamples = double(bandRows) * cols * 1e-6, samples = double(rows) * cols * 1e-6;
+    std::printf("grid:      %dx%d, %d octaves\n", rows, cols, noise.octaves);
+    std::printf("threads:   %u\n", ThreadPool::shared().size());
+#if defined(__AVX2__)
+    std::printf("vector:    AVX2\n");
+#else
+    std::printf("vector:    none (scalar fallback)\n");
+#endif
+    std::printf("scalar:    %.3f s (%.1f Msamples/s, 1 thread, %d rows)\n", scalarSeconds, bandSamples / scalarSeconds,
+                bandRows);
+    std::printf("simd:      %.3f s (%.1f Msamples/s, 1 thread, %d rows), max difference %g\n", vectorSeconds,
+                bandSamples / vectorSeconds, bandRows, maxDifference);
+    std::printf("heights:   %.3f s (%.1f Msamples/s, tiled)\n", heightSeconds, samples / heightSeconds);
+    std::printf("classify:  %.3f s (%.1f Msamples/s)\n", classifySeconds, samples / classifySeconds);
+    std::printf("speedup:   %.1fx simd, %.1fx tiled over scalar\n", scalarSeconds / vectorSeconds,
+                (scalarSeconds / bandSamples) / (heightSeconds / samples));
+    return maxDifference < 1e-4f ? 0 : 2;
+}
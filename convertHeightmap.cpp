@@ -0,0 +1,48 @@
+#include "HeightmapIO.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Converts the legacy .e/.rgb text pair into a binary .hmap container.
+// usage: convertHeightmap <elevation.e> <colors.rgb> <rows> <cols> <output.hmap> [--uint16] [--range <min> <max>]
+int main(int argc, char **argv) {
+    if (argc < 6) {
+        std::cout << "Usage: convertHeightmap <elevation.e> <colors.rgb> <rows> <cols> <output.hmap>"
+                     " [--uint16] [--range <min> <max>]" << std::endl;
+        return 1;
+    }
+    std::string elevationPath = argv[1];
+    std::string rgbPath = argv[2];
+    int rows = std::stoi(argv[3]);
+    int cols = std::stoi(argv[4]);
+    std::string outputPath = argv[5];
+
+    HeightFormat format = HEIGHT_FLOAT32;
+    float minHeight = DEFAULT_MIN_HEIGHT, maxHeight = DEFAULT_MAX_HEIGHT;
+    for (int k = 6; k < argc; k++) {
+        std::string arg = argv[k];
+        if (arg == "--uint16") {
+            format = HEIGHT_UNORM16;
+        } else if (arg == "--range" && k + 2 < argc) {
+            minHeight = std::stof(argv[++k]);
+            maxHeight = std::stof(argv[++k]);
+        } else {
+            std::cerr << "Error: Unknown argument " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    Grid2D<float> heights;
+    Grid2D<glm::u8vec3> colors;
+    if (!readElevationText(elevationPath, rows, cols, heights))
+        return 1;
+    bool hasColors = readRGBText(rgbPath, rows, cols, colors);
+
+    if (!HeightmapFile::write(outputPath, minHeight, maxHeight, heights,
+                              hasColors ? colors : Grid2D<glm::u8vec3>(), format))
+        return 1;
+    std::cout << "rows: " << rows << " cols: " << cols << std::endl;
+    std::cout << "Heightmap saved to " << outputPath << std::endl;
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include "HeightmapIO.h"
+#include "TerrainGenerator.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// Native replacement for processTerrain.py: generates a rows x cols fBm terrain with biome colors under data/
+// and points meta.data at it. Run from the repository root, like the script. The binary .hmap container is
+// written by default, with the --range world heights (main.cpp's -10..0 unless given); --text writes the
+// .e/.rgb pair the script produces instead.
+// usage: generateTerrain <rows> <cols> [--seed n] [--scale s] [--octaves n] [--name perlin]
+//                        [--range <min> <max>] [--text]
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        std::cout << "Usage: generateTerrain <rows> <cols> [--seed n] [--scale s] [--octaves n] [--name perlin]"
+                     " [--range <min> <max>] [--text]" << std::endl;
+        return 1;
+    }
+    int rows = std::stoi(argv[1]);
+    int cols = std::stoi(argv[2]);
+    TerrainNoise noise;
+    std::string name = "perlin";
+    bool text = false;
+    float minHeight = DEFAULT_MIN_HEIGHT, maxHeight = DEFAULT_MAX_HEIGHT;
+    for (int k = 3; k < argc; k++) {
+        std::string arg = argv[k];
+        if (arg == "--seed" && k + 1 < argc) {
+            noise.seed = uint32_t(std::stoul(argv[++k]));
+        } else if (arg == "--scale" && k + 1 < argc) {
+            noise.scale = std::stof(argv[++k]);
+        } else if (arg == "--octaves" && k + 1 < argc) {
+            noise.octaves = std::stoi(argv[++k]);
+        } else if (arg == "--name" && k + 1 < argc) {
+            name = argv[++k];
+        } else if (arg == "--range" && k + 2 < argc) {
+            minHeight = std::stof(argv[++k]);
+            maxHeight = std::stof(argv[++k]);
+        } else if (arg == "--text") {
+            text = true;
+        } else {
+            std::cerr << "Error: Unknown argument " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (rows < 2 || cols < 2) {
+        std::cerr << "Error: A terrain needs at least 2x2 samples" << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Grid2D<float> heights;
+    Grid2D<glm::u8vec3> colors;
+    generateTerrain(noise, rows, cols, heights, colors);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (text) {
+        std::filesystem::create_directories("data/elevation");
+        std::filesystem::create_directories("data/rgb");
+        std::string elevationPath = "data/elevation/" + name + ".e", rgbPath = "data/rgb/" + name + ".rgb";
+        if (!writeHeightmapText(elevationPath, rgbPath, heights, colors))
+            return 1;
+        std::cout << "Elevation saved to " << elevationPath << std::endl;
+        std::cout << "Biome colors saved to " << rgbPath << std::endl;
+    } else {
+        std::filesystem::create_directories("data/binary");
+        std::string binaryPath = "data/binary/" + name + ".hmap";
+        if (!HeightmapFile::write(binaryPath, minHeight, maxHeight, heights, colors))
+            return 1;
+        std::cout << "Heightmap saved to " << binaryPath << std::endl;
+    }
+
+    std::ofstream meta("meta.data");
+    meta << name << "\n" << rows << " " << cols << "\n";
+    if (!meta) {
+        std::cerr << "Error: Could not write meta.data" << std::endl;
+        return 1;
+    }
+    std::cout << "rows: " << rows << " cols: " << cols << " seed: " << noise.seed << std::endl;
+    std::printf("generated in %.3f s (%.1f Msamples/s)\n", seconds, double(rows) * cols / seconds * 1e-6);
+    return 0;
+}
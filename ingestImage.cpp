@@ -0,0 +1,75 @@
+#include "HeightmapIO.h"
+#include "ImageHeightmap.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// Native replacement for processImage.py: turns a photo into a heightmap under data/ and points meta.data
+// at it. Run from the repository root, like the script. The binary .hmap container is written by default;
+// its world heights are --range (main.cpp's -10..0 unless given). --text writes the .e/.rgb pair processImage.py
+// produces instead.
+// usage: ingestImage <image> [--max-triangles <count>] [--range <min> <max>] [--text]
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cout << "Usage: ingestImage <image> [--max-triangles <count>] [--range <min> <max>] [--text]"
+                  << std::endl;
+        return 1;
+    }
+    std::string imagePath = argv[1];
+    int maxTriangles = DEFAULT_IMAGE_TRIANGLES;
+    bool text = false;
+    float minHeight = DEFAULT_MIN_HEIGHT, maxHeight = DEFAULT_MAX_HEIGHT;
+    for (int k = 2; k < argc; k++) {
+        std::string arg = argv[k];
+        if (arg == "--max-triangles" && k + 1 < argc) {
+            maxTriangles = std::stoi(argv[++k]);
+        } else if (arg == "--range" && k + 2 < argc) {
+            minHeight = std::stof(argv[++k]);
+            maxHeight = std::stof(argv[++k]);
+        } else if (arg == "--text") {
+            text = true;
+        } else {
+            std::cerr << "Error: Unknown argument " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Grid2D<float> heights;
+    Grid2D<glm::u8vec3> colors;
+    if (!loadImageHeightmap(imagePath, maxTriangles, heights, colors))
+        return 1;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::string name = std::filesystem::path(imagePath).stem().string();
+    if (text) {
+        std::filesystem::create_directories("data/elevation");
+        std::filesystem::create_directories("data/rgb");
+        std::string elevationPath = "data/elevation/" + name + ".e", rgbPath = "data/rgb/" + name + ".rgb";
+        if (!writeHeightmapText(elevationPath, rgbPath, heights, colors))
+            return 1;
+        std::cout << "Normalized Height map saved to " << elevationPath << std::endl;
+        std::cout << "Normalized Colors saved to " << rgbPath << std::endl;
+    } else {
+        std::filesystem::create_directories("data/binary");
+        std::string binaryPath = "data/binary/" + name + ".hmap";
+        if (!HeightmapFile::write(binaryPath, minHeight, maxHeight, heights, colors))
+            return 1;
+        std::cout << "Heightmap saved to " << binaryPath << std::endl;
+    }
+
+    std::ofstream meta("meta.data");
+    meta << name << "\n" << heights.rows() << " " << heights.cols() << "\n";
+    if (!meta) {
+        std::cerr << "Error: Could not write meta.data" << std::endl;
+        return 1;
+    }
+    std::cout << "rows: " << heights.rows() << " cols: " << heights.cols() << std::endl;
+    std::cout << "meta.data saved to meta.data (image processed in " << seconds * 1000.0 << " ms)" << std::endl;
+    return 0;
+}
@@ -10,7 +10,19 @@
 #include "Triangle.h"
 #include "Cube.h"
 #include "Map.h"
-
+#include "ThreadPool.h"
+#include "Scene.h"
+#include "FrameProfiler.h"
+#include "TextOverlay.h"
+#include "Trace.h"
+#include "ImageHeightmap.h"
+#include "TerrainGenerator.h"
+#include "StreamingMap.h"
+#include "HeadlessContext.h"
+#include "OffscreenTarget.h"
+#include "PngWriter.h"
+
+#include <cstdio>
 #include <iostream>
 #include <random>
 
@@ -24,6 +36,8 @@ void processInput(GLFWwindow *window);
 
 void readMetadata(const std::string &metadataPath, int &rows, int &cols, std::string &name);
 
+int renderHeadless(Map &map, Cube &cube, const std::string &posesPath, int width, int height);
+
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
@@ -32,6 +46,10 @@ const unsigned int SCR_HEIGHT = 600;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 float cambio_escala = 1.0f;
+float height_exaggeration = 1.0f;
+float lod_error = 2.0f;
+float max_error = 0.5f;
+bool show_profiler = false;
 
 
 int min_height = -10;
@@ -48,16 +66,156 @@ float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
 
 
-int main() {
+int main(int argc, char **argv) {
+    // command line options
+    unsigned threads = 0;
+    bool gpuDisplacement = false;
+    bool lod = false;
+    bool simplify = false;
+    bool occlusion = false;
+    std::string posesPath;
+    std::string recordPath;
+    std::string profilePath;
+    std::string tracePath;
+    std::string imagePath;
+    int maxTriangles = DEFAULT_IMAGE_TRIANGLES;
+    int generateRows = 0, generateCols = 0;
+    std::string tilesPath;
+    size_t cacheMegabytes = 512;
+    size_t uploadMegabytes = DEFAULT_UPLOAD_FRAME_BUDGET >> 20;
+    TerrainNoise noise;
+    int width = SCR_WIDTH, height = SCR_HEIGHT;
+    for (int k = 1; k < argc; k++) {
+        std::string arg = argv[k];
+        if (arg == "--threads" && k + 1 < argc) {
+            threads = unsigned(std::stoi(argv[++k]));
+        } else if (arg == "--gpu-displacement") {
+            gpuDisplacement = true;
+        } else if (arg == "--lod") {
+            lod = true;
+        } else if (arg == "--simplify" && k + 1 < argc) {
+            simplify = true;
+            max_error = std::stof(argv[++k]);
+        } else if (arg == "--occlusion") {
+            occlusion = true;
+        } else if (arg == "--headless" && k + 1 < argc) {
+            posesPath = argv[++k];
+        } else if (arg == "--image" && k + 1 < argc) {
+            imagePath = argv[++k];
+        } else if (arg == "--max-triangles" && k + 1 < argc) {
+            maxTriangles = std::stoi(argv[++k]);
+        } else if (arg == "--generate" && k + 1 < argc) {
+            if (std::sscanf(argv[++k], "%dx%d", &generateRows, &generateCols) != 2 || generateRows < 2 ||
+                generateCols < 2) {
+                std::cout << "Invalid --generate, expected <rows>x<cols>" << std::endl;
+                return -1;
+            }
+        } else if (arg == "--tiles" && k + 1 < argc) {
+            tilesPath = argv[++k];
+        } else if (arg == "--cache-mb" && k + 1 < argc) {
+            cacheMegabytes = size_t(std::stoul(argv[++k]));
+        } else if (arg == "--upload-mb" && k + 1 < argc) {
+            uploadMegabytes = size_t(std::stoul(argv[++k]));
+        } else if (arg == "--seed" && k + 1 < argc) {
+            noise.seed = uint32_t(std::stoul(argv[++k]));
+        } else if (arg == "--trace" && k + 1 < argc) {
+            tracePath = argv[++k];
+        } else if (arg == "--profile" && k + 1 < argc) {
+            profilePath = argv[++k];
+        } else if (arg == "--record" && k + 1 < argc) {
+            recordPath = argv[++k];
+        } else if (arg == "--size" && k + 1 < argc) {
+            if (std::sscanf(argv[++k], "%dx%d", &width, &height) != 2)
+                width = height = 0;
+        } else {
+            std::cout << "Usage: " << argv[0]
+                      << " [--threads <count>] [--gpu-displacement] [--lod] [--simplify <max error>] [--occlusion]"
+                      << " [--headless <pose file> [--size <width>x<height>]] [--record <camera path file>]"
+                      << " [--profile <stats.csv|stats.json>] [--trace <trace.json>]"
+                      << " [--image <photo> [--max-triangles <count>]] [--generate <rows>x<cols> [--seed <n>]]"
+                      << " [--tiles <map.tiles> [--cache-mb <budget>] [--upload-mb <per frame>]]"
+                      << std::endl;
+            return -1;
+        }
+    }
+    if (width <= 0 || height <= 0) {
+        std::cout << "Invalid --size, expected <width>x<height>" << std::endl;
+        return -1;
+    }
+    if (!tilesPath.empty() && !posesPath.empty()) {
+        std::cout << "--headless renders whole maps; --tiles streams them into a window" << std::endl;
+        return -1;
+    }
+    if (!tilesPath.empty() && (!imagePath.empty() || generateRows > 0)) {
+        std::cout << "--image and --generate build the map in memory; --tiles streams it from a tile set" << std::endl;
+        return -1;
+    }
+    // zones from here on are written to tracePath on exit, as Chrome trace events
+    if (!tracePath.empty())
+        Trace::enable();
+    Trace::nameThread("main");
+    // worker threads used to load and mesh the map (0 = one per hardware thread)
+    ThreadPool::shared(threads);
+
+    // a photo given with --image and a --generate terrain are built and meshed in memory; otherwise meta.data
+    // names the map
     std::string metadata = "../meta.data";
     std::string name;
-    readMetadata(metadata, rows, cols, name);
+    Grid2D<float> memoryHeights;
+    Grid2D<glm::u8vec3> memoryColors;
+    // a tile set (tileHeightmap) is streamed around the camera instead of loaded whole
+    StreamingMap streaming(tilesPath);
+    if (!tilesPath.empty()) {
+        if (!streaming.open())
+            return -1;
+        streaming.set_cache_budget(cacheMegabytes << 20);
+        streaming.set_upload_budget(uploadMegabytes << 20);
+        rows = streaming.rows();
+        cols = streaming.cols();
+    } else if (!imagePath.empty() && !loadImageHeightmap(imagePath, maxTriangles, memoryHeights, memoryColors))
+        return -1;
+    if (imagePath.empty() && generateRows > 0)
+        generateTerrain(noise, generateRows, generateCols, memoryHeights, memoryColors);
+    if (!memoryHeights.empty()) {
+        rows = memoryHeights.rows();
+        cols = memoryHeights.cols();
+    } else if (tilesPath.empty()) {
+        readMetadata(metadata, rows, cols, name);
+    }
+    lightPos = glm::vec3(rows / 2, max_height + 5, cols / 2);
+    camera = glm::vec3(rows / 2, max_height + 50, cols / 2);
     std::string elevationPath = "../data/elevation/" + name + ".e";
     std::string rgbPath = "../data/rgb/" + name + ".rgb";
+    std::string binaryPath = "../data/binary/" + name + ".hmap";
 
     Map map(rows, cols, min_height, max_height, elevationPath, rgbPath);
+    // prefer the binary container written by convertHeightmap when there is one
+    if (!memoryHeights.empty())
+        map.use_heightmap(memoryHeights, memoryColors);
+    else if (std::ifstream(binaryPath).good())
+        map.use_binary(binaryPath);
     map.change_proximity(1.0);
+    map.use_gpu_displacement(gpuDisplacement);
+    map.use_lod(lod);
+    map.use_simplification(simplify);
+    map.use_occlusion_culling(occlusion);
+    map.set_max_error(max_error);
+    map.set_progress_callback([](size_t done, size_t total) {
+        static size_t lastDecile = 0;
+        size_t decile = done * 10 / total;
+        if (decile != lastDecile) {
+            lastDecile = decile;
+            std::cout << "\rBuilding terrain mesh: " << decile * 10 << "%" << (decile == 10 ? "\n" : "") << std::flush;
+        }
+    });
     Cube cube(lightPos);
+    if (!posesPath.empty()) {
+        int status = renderHeadless(map, cube, posesPath, width, height);
+        if (!tracePath.empty() && !Trace::write(tracePath))
+            std::cerr << "Error: Unable to write " << tracePath << std::endl;
+        return status;
+    }
+
     // glfw: initialize and configure
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -92,53 +250,110 @@ int main() {
     // configure global opengl state
     glEnable(GL_DEPTH_TEST);
     // build and compile our shader zprogram
-    Shader lightingShader("../shaders/basic_lighting.vs", "../shaders/basic_lighting.fs");
-    //Shader lightingShader("../1.basico_sin_luz.vs", "../1.basico_sin_luz.fs");
-    Shader lightCubeShader("../shaders/light_source.vs", "../shaders/light_source.fs");
+    Scene scene;
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // first, configure the cube's VAO (and VBO)
-    map.setup();
+    if (tilesPath.empty())
+        map.setup();
+    else
+        streaming.setup();
     cube.setup();
+    // height exaggeration scales the range the map was loaded with, e.g. the one in a .hmap or .tiles header
+    const double baseMinHeight = tilesPath.empty() ? map.min_elevation() : streaming.min_elevation();
+    const double baseMaxHeight = tilesPath.empty() ? map.max_elevation() : streaming.max_elevation();
+
+    // per-stage timings, shown with P and written once a second with --profile
+    FrameProfiler profiler;
+    profiler.setup();
+    TextOverlay overlay;
+    overlay.setup();
+    std::FILE *profileFile = profilePath.empty() ? nullptr : std::fopen(profilePath.c_str(), "w");
+    if (!profilePath.empty() && profileFile == nullptr) {
+        std::cerr << "Error: Unable to write " << profilePath << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    bool profileJson = profilePath.size() >= 5 && profilePath.compare(profilePath.size() - 5, 5, ".json") == 0;
+
+    // camera pose of every frame, replayable by benchmarkRender --path
+    std::ofstream record;
+    if (!recordPath.empty())
+        record.open(recordPath);
 
     // render loop
     while (!glfwWindowShouldClose(window)) {
+        TRACE_ZONE("frame");
         // per-frame time logic
         float currentFrame = static_cast<float>(glfwGetTime());
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        profiler.beginFrame();
 
         // input
-        processInput(window);
+        {
+            TRACE_ZONE("input");
+            processInput(window);
+        }
+        if (record.is_open())
+            record << camera.Position.x << ' ' << camera.Position.y << ' ' << camera.Position.z << ' ' << camera.Yaw
+                   << ' ' << camera.Pitch << '\n';
 
         // render
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        // be sure to activate shader when setting uniforms/drawing objects
-        lightingShader.use();
-        lightingShader.setVec3("objectColor", 1.0f, 0.5f, 0.31f);
-        lightingShader.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
-        lightingShader.setVec3("lightPos", lightPos);
-        lightingShader.setVec3("viewPos", camera.Position);
-        cube.updatePos(lightPos);
-
-        // view/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f,
-                                                100.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        lightingShader.setMat4("projection", projection);
-        lightingShader.setMat4("view", view);
-        map.display(lightingShader, cambio_escala);
-
-        lightCubeShader.use();
-        lightCubeShader.setMat4("projection", projection);
-        lightCubeShader.setMat4("view", view);
-        cube.display(lightCubeShader);
+        if (tilesPath.empty()) {
+            map.set_height_range(baseMinHeight * height_exaggeration, baseMaxHeight * height_exaggeration);
+            map.set_lod_error(lod_error);
+            map.set_max_error(max_error);
+            scene.draw(map, cube, camera, lightPos, cambio_escala, SCR_WIDTH, SCR_HEIGHT, &profiler);
+        } else {
+            streaming.set_height_range(baseMinHeight * height_exaggeration, baseMaxHeight * height_exaggeration);
+            scene.draw(streaming, cube, camera, lightPos, cambio_escala, SCR_WIDTH, SCR_HEIGHT, &profiler);
+        }
+        if (show_profiler) {
+            FrameProfiler::Scope scope(&profiler, FrameProfiler::OVERLAY);
+            overlay.draw(profiler.summary(), SCR_WIDTH, SCR_HEIGHT);
+        }
+
+        // culling stats in the title, refreshed once a second
+        static float lastStats = 0.0f;
+        if (currentFrame - lastStats >= 1.0f) {
+            lastStats = currentFrame;
+            std::string title;
+            if (tilesPath.empty()) {
+                const Map::FrameStats &stats = map.frame_stats();
+                title = "LearnOpenGL - chunks " + std::to_string(stats.visibleChunks) + "/" +
+                        std::to_string(stats.chunks) + ", draws " + std::to_string(stats.drawCalls) +
+                        ", triangles " + std::to_string(stats.triangles);
+                if (map.uses_lod())
+                    title += ", LOD error " + std::to_string(map.lod_error()) + " px";
+                if (map.uses_simplification())
+                    title += ", max error " + std::to_string(map.max_error());
+                if (map.uses_occlusion_culling())
+                    title += ", culled " + std::to_string(stats.frustumCulled) + " frustum / " +
+                             std::to_string(stats.occlusionCulled) + " occlusion";
+            } else {
+                const StreamingMap::FrameStats &stats = streaming.frame_stats();
+                title = "LearnOpenGL - tiles " + std::to_string(stats.visibleChunks) + " drawn, " +
+                        std::to_string(stats.residentTiles) + " resident (" +
+                        std::to_string(stats.residentBytes >> 20) + " MB), " + std::to_string(stats.pendingTiles) +
+                        " pending, triangles " + std::to_string(stats.triangles);
+            }
+            glfwSetWindowTitle(window, title.c_str());
+            if (profileFile != nullptr)
+                profiler.dump(profileFile, profileJson, currentFrame);
+        }
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        glfwSwapBuffers(window);
+        {
+            FrameProfiler::Scope scope(&profiler, FrameProfiler::SWAP);
+            glfwSwapBuffers(window);
+        }
         glfwPollEvents();
     }
+    if (profileFile != nullptr)
+        std::fclose(profileFile);
+    if (!tracePath.empty() && !Trace::write(tracePath))
+        std::cerr << "Error: Unable to write " << tracePath << std::endl;
 
     // optional: de-allocate all resources once they've outlived their purpose:
 
@@ -148,6 +363,70 @@ int main() {
     return 0;
 }
 
+// Renders one PNG per line of the pose file ("x y z yaw pitch output.png"; blank lines and lines starting with
+// '#' are skipped) into an offscreen framebuffer, without a window system. The readback of each image overlaps
+// the drawing of the next one.
+int renderHeadless(Map &map, Cube &cube, const std::string &posesPath, int width, int height) {
+    std::ifstream poses(posesPath);
+    if (!poses.is_open()) {
+        std::cerr << "Error: Unable to open pose file " << posesPath << std::endl;
+        return -1;
+    }
+    HeadlessContext context;
+    if (!context.create())
+        return -1;
+    if (!gladLoadGLLoader((GLADloadproc) HeadlessContext::procAddress)) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+    glEnable(GL_DEPTH_TEST);
+    Scene scene;
+    map.setup();
+    cube.setup();
+    OffscreenTarget target;
+    if (!target.setup(width, height))
+        return -1;
+    target.bind();
+    map.set_height_range(map.min_elevation() * height_exaggeration, map.max_elevation() * height_exaggeration);
+    map.set_lod_error(lod_error);
+    map.set_max_error(max_error);
+
+    std::vector<unsigned char> pixels;
+    std::string pending; // image waiting in the other pack buffer
+    int slot = 0, failures = 0;
+    auto writePending = [&]() {
+        if (pending.empty())
+            return;
+        if (!target.mapPixels(1 - slot, pixels) || !PngWriter::write(pending, width, height, pixels.data(), true)) {
+            std::cerr << "Error: Unable to write " << pending << std::endl;
+            failures++;
+        }
+        pending.clear();
+    };
+    std::string line;
+    for (int lineNumber = 1; std::getline(poses, line); lineNumber++) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream iss(line);
+        glm::vec3 position;
+        float yaw, pitch;
+        std::string output;
+        if (!(iss >> position.x >> position.y >> position.z >> yaw >> pitch >> output)) {
+            std::cerr << "Error: Malformed pose on line " << lineNumber << " of " << posesPath << std::endl;
+            failures++;
+            continue;
+        }
+        camera = Camera(position, glm::vec3(0.0f, 1.0f, 0.0f), yaw, pitch);
+        scene.draw(map, cube, camera, lightPos, cambio_escala, width, height);
+        target.readPixels(slot);
+        writePending();
+        pending = output;
+        slot = 1 - slot;
+    }
+    writePending();
+    return failures == 0 ? 0 : -1;
+}
+
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 void processInput(GLFWwindow *window) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
@@ -165,6 +444,18 @@ void processInput(GLFWwindow *window) {
         cambio_escala *= 1.001;
     if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS)
         cambio_escala /= 1.001;
+    if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS)
+        height_exaggeration /= 1.01;
+    if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS)
+        height_exaggeration *= 1.01;
+    if (glfwGetKey(window, GLFW_KEY_5) == GLFW_PRESS)
+        lod_error /= 1.01;
+    if (glfwGetKey(window, GLFW_KEY_6) == GLFW_PRESS)
+        lod_error *= 1.01;
+    if (glfwGetKey(window, GLFW_KEY_7) == GLFW_PRESS)
+        max_error /= 1.01;
+    if (glfwGetKey(window, GLFW_KEY_8) == GLFW_PRESS)
+        max_error *= 1.01;
     if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
         lightPos += glm::vec3(2.0f / 10.0f, 0, 0);
     if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
@@ -177,6 +468,12 @@ void processInput(GLFWwindow *window) {
         lightPos += glm::vec3(0, -2.0f / 10.0f, 0);
     if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS)
         lightPos += glm::vec3(0, 2.0f / 10.0f, 0);
+    // P toggles the profiler overlay once per press
+    static bool profilerKeyDown = false;
+    bool profilerKey = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+    if (profilerKey && !profilerKeyDown)
+        show_profiler = !show_profiler;
+    profilerKeyDown = profilerKey;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -213,6 +510,7 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
 }
 
 void readMetadata(const std::string &metadataPath, int &rows, int &cols, std::string &name) {
+    TRACE_ZONE("readMetadata");
     // Read the metadata file
     std::ifstream metadataFile(metadataPath);
     if (metadataFile.is_open()) {
@@ -237,7 +535,4 @@ void readMetadata(const std::string &metadataPath, int &rows, int &cols, std::st
         std::cerr << "Error: Unable to open metadata file." << std::endl;
         return; // Return an error code
     }
-    lightPos = glm::vec3(rows / 2, max_height + 5, cols / 2);
-    camera = glm::vec3(rows / 2, max_height + 50, cols / 2);
-
 }
\ No newline at end of file
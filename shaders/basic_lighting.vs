@@ -1,18 +1,53 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 0) in vec2 aHeight;   // normalized (height, height at the next coarser LOD level)
+layout (location = 1) in vec2 aNormal;   // octahedral
+layout (location = 2) in vec3 aColor;
 
 out vec3 FragPos;
 out vec3 Normal;
+out vec3 Color;
+
+// TerrainMesh::setGrid: vertex k is grid sample gridOrigin + (k / gridCols, k % gridCols), clamped to gridLast
+uniform ivec2 gridOrigin;
+uniform int gridCols;
+uniform ivec2 gridLast;
+uniform float spacing;
+uniform float heightScale;     // max_height - min_height
+uniform float heightOffset;    // min_height
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform FrameData
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+};
+
+// octahedral normal folded around +y (packOctahedral16 in NormalKernel.h)
+vec3 decodeNormal(vec2 e)
+{
+    vec3 n = vec3(e.x, 1.0 - abs(e.x) - abs(e.y), e.y);
+    float t = max(-n.y, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.z += n.z >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+ivec2 gridCell()
+{
+    return min(gridOrigin + ivec2(gl_VertexID / gridCols, gl_VertexID % gridCols), gridLast);
+}
 
 void main()
 {
+    ivec2 cell = gridCell();
+    vec3 aPos = vec3(float(cell.x) * spacing, aHeight.x * heightScale + heightOffset, float(cell.y) * spacing);
+
     FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    Normal = mat3(transpose(inverse(model))) * decodeNormal(aNormal);
+    Color = aColor;
 
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,55 @@
+#version 330 core
+out vec3 FragPos;
+out vec3 Normal;
+out vec3 Color;
+
+uniform sampler2D heightMap;   // normalized heights, R32F, one texel per sample
+uniform sampler2D colorMap;    // RGB8, one texel per sample
+uniform ivec2 gridSize;        // (rows, cols)
+uniform float heightScale;     // max_height - min_height
+uniform float heightOffset;    // min_height
+uniform float spacing;
+uniform isamplerBuffer chunkTable;  // per chunk: (first quad row, first quad col, quads per row, 0)
+uniform int chunkVertices;          // vertex IDs per chunk; chunk c is drawn from c * chunkVertices
+uniform int chunkBase;              // chunk drawn from vertex 0 when the chunks are drawn one per call, else 0
+
+uniform mat4 model;
+layout (std140) uniform FrameData
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+};
+
+// the two triangles of a quad, in the same order as Map::buildIndices
+const ivec2 corners[6] = ivec2[6](ivec2(0, 1), ivec2(0, 0), ivec2(1, 0),
+                                  ivec2(1, 1), ivec2(0, 1), ivec2(1, 0));
+
+float height(ivec2 cell)
+{
+    return texelFetch(heightMap, cell.yx, 0).r * heightScale + heightOffset;
+}
+
+void main()
+{
+    ivec4 chunk = texelFetch(chunkTable, chunkBase + gl_VertexID / chunkVertices);
+    int vertex = gl_VertexID % chunkVertices;
+    int quad = vertex / 6;
+    ivec2 cell = chunk.xy + ivec2(quad / chunk.z, quad % chunk.z) + corners[vertex % 6];
+
+    // central differences, one-sided on the borders
+    ivec2 lo = max(cell - 1, ivec2(0));
+    ivec2 hi = min(cell + 1, gridSize - 1);
+    float dx = (height(ivec2(hi.x, cell.y)) - height(ivec2(lo.x, cell.y))) / (float(max(hi.x - lo.x, 1)) * spacing);
+    float dz = (height(ivec2(cell.x, hi.y)) - height(ivec2(cell.x, lo.y))) / (float(max(hi.y - lo.y, 1)) * spacing);
+    vec3 aNormal = normalize(vec3(-dx, 1.0, -dz));
+    vec3 aPos = vec3(float(cell.x) * spacing, height(cell), float(cell.y) * spacing);
+
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    Normal = mat3(transpose(inverse(model))) * aNormal;
+    Color = texelFetch(colorMap, cell.yx, 0).rgb;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,85 @@
+#version 330 core
+layout (location = 0) in vec2 aHeight;  // normalized (height, height at the next coarser level)
+layout (location = 1) in vec2 aNormal;  // octahedral
+layout (location = 2) in vec3 aColor;
+layout (location = 3) in float aLevel;  // level the vertex is dropped at
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec3 Color;
+
+const int MAX_LEVELS = 16;         // TerrainLod::MAX_LEVELS
+uniform samplerBuffer chunkErrors; // TerrainLod::setup: normalized error of every level, per chunk grid cell
+uniform int chunkSize;
+uniform ivec2 chunkGrid;           // chunk grid rows, cols
+uniform int maxLevel;
+uniform float morphScale;          // distance per unit of error at which TerrainLod::select drops a level
+uniform float morphRegion;         // fraction of that distance spent blending
+uniform vec3 eyePos;               // camera position in model space
+
+// TerrainMesh::setGrid: vertex k is grid sample gridOrigin + (k / gridCols, k % gridCols), clamped to gridLast
+uniform ivec2 gridOrigin;
+uniform int gridCols;
+uniform ivec2 gridLast;
+uniform float spacing;
+uniform float heightScale;     // max_height - min_height
+uniform float heightOffset;    // min_height
+
+uniform mat4 model;
+layout (std140) uniform FrameData
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+};
+
+// octahedral normal folded around +y (packOctahedral16 in NormalKernel.h)
+vec3 decodeNormal(vec2 e)
+{
+    vec3 n = vec3(e.x, 1.0 - abs(e.x) - abs(e.y), e.y);
+    float t = max(-n.y, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.z += n.z >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+ivec2 gridCell()
+{
+    return min(gridOrigin + ivec2(gl_VertexID / gridCols, gl_VertexID % gridCols), gridLast);
+}
+
+// Distance at which the first of the chunks sharing the vertex drops `level`
+float morphEnd(ivec2 cell, int level)
+{
+    ivec2 first = min(max(cell - 1, 0) / chunkSize, chunkGrid - 1);
+    ivec2 last = min(cell / chunkSize, chunkGrid - 1);
+    float error = 1e20;
+    for (int row = first.x; row <= last.x; row++)
+        for (int col = first.y; col <= last.y; col++)
+            error = min(error, texelFetch(chunkErrors, (row * chunkGrid.y + col) * MAX_LEVELS + level + 1).r);
+    return error * morphScale;
+}
+
+void main()
+{
+    ivec2 cell = gridCell();
+    vec3 aPos = vec3(float(cell.x) * spacing, aHeight.x * heightScale + heightOffset, float(cell.y) * spacing);
+
+    // depends only on the vertex and the eye, so every chunk sharing the vertex moves it the same way
+    int level = int(aLevel);
+    float morph = 0.0;
+    if (level < maxLevel) {
+        float end = morphEnd(cell, level);
+        float start = end * (1.0 - morphRegion);
+        morph = clamp((distance(aPos, eyePos) - start) / max(end - start, 1e-4), 0.0, 1.0);
+    }
+    vec3 pos = vec3(aPos.x, mix(aHeight.x, aHeight.y, morph) * heightScale + heightOffset, aPos.z);
+
+    FragPos = vec3(model * vec4(pos, 1.0));
+    Normal = mat3(transpose(inverse(model))) * decodeNormal(aNormal);
+    Color = aColor;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
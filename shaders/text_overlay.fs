@@ -0,0 +1,12 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform sampler2D glyphs;
+
+void main()
+{
+    float ink = texture(glyphs, TexCoord).r;
+    FragColor = mix(vec4(0.0, 0.0, 0.0, 0.6), vec4(1.0, 1.0, 0.8, 1.0), ink);
+}
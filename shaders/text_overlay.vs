@@ -0,0 +1,13 @@
+#version 330 core
+layout (location = 0) in vec2 aPos; // pixels from the top-left corner
+layout (location = 1) in vec2 aTexCoord;
+
+out vec2 TexCoord;
+
+uniform vec2 viewportSize;
+
+void main()
+{
+    TexCoord = aTexCoord;
+    gl_Position = vec4(aPos.x / viewportSize.x * 2.0 - 1.0, 1.0 - aPos.y / viewportSize.y * 2.0, 0.0, 1.0);
+}
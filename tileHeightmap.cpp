@@ -0,0 +1,58 @@
+#include "TiledHeightmap.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+// Cuts a binary .hmap heightmap into the tiled .tiles container StreamingMap reads. The input is mapped, not
+// loaded, so it may be larger than memory.
+// usage: tileHeightmap <input.hmap> <output.tiles> [--tile <quads>] [--uint16]
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        std::cout << "Usage: tileHeightmap <input.hmap> <output.tiles> [--tile <quads>] [--uint16]" << std::endl;
+        return 1;
+    }
+    std::string inputPath = argv[1];
+    std::string outputPath = argv[2];
+    int tileSize = DEFAULT_TILE_SIZE;
+    HeightFormat format = HEIGHT_FLOAT32;
+    for (int k = 3; k < argc; k++) {
+        std::string arg = argv[k];
+        if (arg == "--tile" && k + 1 < argc) {
+            tileSize = std::stoi(argv[++k]);
+        } else if (arg == "--uint16") {
+            format = HEIGHT_UNORM16;
+        } else {
+            std::cerr << "Error: Unknown argument " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (tileSize < 1) {
+        std::cerr << "Error: Tiles need at least one quad" << std::endl;
+        return 1;
+    }
+
+    HeightmapFile input;
+    if (!input.open(inputPath))
+        return 1;
+    const HeightmapHeader &header = input.header();
+    if (header.rows < 2 || header.cols < 2) {
+        std::cerr << "Error: " << inputPath << " has fewer than 2x2 samples" << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    bool written = header.format == HEIGHT_FLOAT32
+                   ? TileSetFile::write(outputPath, header.minHeight, header.maxHeight, input.heights32(), input.rgb(),
+                                        tileSize, format)
+                   : TileSetFile::write(outputPath, header.minHeight, header.maxHeight, input.heights16(), input.rgb(),
+                                        tileSize, format);
+    if (!written)
+        return 1;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "rows: " << header.rows << " cols: " << header.cols << " tiles: "
+              << (header.rows - 2) / tileSize + 1 << "x" << (header.cols - 2) / tileSize + 1 << std::endl;
+    std::printf("Tile set saved to %s in %.2f s\n", outputPath.c_str(), seconds);
+    return 0;
+}